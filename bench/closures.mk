@@ -0,0 +1,29 @@
+# closure-heavy code: captured variables, currying and composition
+let makeAdder = fn(x) { fn(y) { x + y } };
+let compose = fn(f, g) { fn(x) { g(f(x)) } };
+let twice = fn(f) { compose(f, f) };
+
+let counter = fn(start) {
+    let step = fn(n) { fn(m) { n + m } };
+    fn(k) { step(start)(k) }
+};
+
+let run = fn(i, n, total) {
+    if (i == n) {
+        return total;
+    }
+    let addI = makeAdder(i);
+    let addTwo = twice(makeAdder(1));
+    let pipeline = compose(addI, addTwo);
+    let c = counter(i);
+    return run(i + 1, n, total + pipeline(1) - c(1));
+};
+
+let repeat = fn(times, total) {
+    if (times == 0) {
+        return total;
+    }
+    return repeat(times - 1, total + run(0, 150, 0));
+};
+
+print(repeat(25, 0));
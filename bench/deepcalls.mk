@@ -0,0 +1,32 @@
+# deep call chains: deep recursion and long chains of nested calls
+let depth = fn(n) {
+    if (n == 0) {
+        return 0;
+    }
+    return 1 + depth(n - 1);
+};
+
+let callOne = fn(x) { x + 1 };
+let callTwo = fn(x) { callOne(x) + 1 };
+let callThree = fn(x) { callTwo(x) + 1 };
+let callFour = fn(x) { callThree(x) + 1 };
+let callFive = fn(x) { callFour(x) + 1 };
+let callSix = fn(x) { callFive(x) + 1 };
+let callSeven = fn(x) { callSix(x) + 1 };
+let callEight = fn(x) { callSeven(x) + 1 };
+
+let chain = fn(i, n, total) {
+    if (i == n) {
+        return total;
+    }
+    return chain(i + 1, n, total + callEight(0) - 8);
+};
+
+let repeat = fn(times, total) {
+    if (times == 0) {
+        return total;
+    }
+    return repeat(times - 1, total + depth(500) + chain(0, 300, 0));
+};
+
+print(repeat(20, 0));
@@ -0,0 +1,9 @@
+# recursive fibonacci: call overhead and integer arithmetic
+let fib = fn(n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+};
+
+print(fib(20));
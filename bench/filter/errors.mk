@@ -0,0 +1,9 @@
+# monkey filter: keep the api requests that failed, upper-casing their path
+let process = fn(line) {
+    if (contains(line, "/api/")) {
+        let f = split(line);
+        if (find(f[4], "5") == 0) {
+            f[0] + " " + upper(f[3])
+        }
+    }
+};
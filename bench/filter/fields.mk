@@ -0,0 +1,8 @@
+# monkey filter: print the ip, method and status of every request, like awk '{ print $1, $3, $5 }'
+let process = fn(line) {
+    let f = split(line);
+    f[0] + " " + f[2] + " " + f[4]
+};
+
+# with --fn=fields --batch=N: the same work over N lines per call
+let fields = fn(lines) { map(lines, process) };
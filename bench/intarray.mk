@@ -0,0 +1,18 @@
+# sum/min/max/dot over a packed array of 262144 integers, 20 rounds
+let grow = fn(a, times) {
+    if (times == 0) {
+        return a;
+    }
+    let n = len(a);
+    return grow(concat(a, map(a, fn(x) { x + n })), times - 1);
+};
+
+let numbers = grow([0], 18);
+let weights = re(numbers);
+let round = fn(i, acc) {
+    if (i == 0) {
+        return acc;
+    }
+    return round(i - 1, acc + sum(numbers) + max(numbers) - min(weights) + dot(numbers, weights) / 1000000);
+};
+print(round(20, 0));
@@ -0,0 +1,27 @@
+# log processing with the string builtins: split, find, contains, join, replace, trim, upper/lower
+let grow = fn(a, times) {
+    if (times == 0) {
+        return a;
+    }
+    let n = len(a);
+    return grow(concat(a, map(a, fn(x) { x + n })), times - 1);
+};
+
+let methods = ["get", "post", "put", "delete"];
+let paths = ["/index.html", "/api/users", "/api/orders/42", "/static/app.js", "/login"];
+let statuses = ["200", "200", "200", "404", "500", "302"];
+let makeLine = fn(i) {
+    "  10.0.0." + str(i - i / 256 * 256) + " - " + methods[i - i / 4 * 4] + " " + paths[i - i / 5 * 5]
+        + " " + statuses[i - i / 6 * 6] + " " + str(i * 37 - i * 37 / 5000 * 5000) + "  "
+};
+
+let text = join(map(grow([0], 14), makeLine), " | ");
+let lines = split(text, " | ");
+let parse = fn(line) {
+    let fields = split(trim(line));
+    { "ip": fields[0], "method": upper(fields[2]), "path": replace(fields[3], "/api/", "/v2/"), "status": fields[4] }
+};
+let records = map(lines, parse);
+let errors = filter(records, fn(r) { find(r["status"], "5") == 0 });
+let api = filter(lines, fn(line) { contains(line, "/api/") });
+print(len(lines), len(errors), len(api), records[1]["method"], records[1]["path"], lower(records[2]["method"]));
@@ -0,0 +1,31 @@
+# flat loops: while/for with local and global reassignment
+let sumTo = fn(n) {
+    let total = 0;
+    for (let i = 0; i < n; i = i + 1) {
+        total = total + i;
+    }
+    total
+};
+
+let collatz = fn(n) {
+    let steps = 0;
+    while (n != 1) {
+        if (n - (n / 2) * 2 == 0) {
+            n = n / 2;
+        } else {
+            n = 3 * n + 1;
+        }
+        steps = steps + 1;
+    }
+    steps
+};
+
+let longest = 0;
+for (let k = 1; k < 300; k = k + 1) {
+    let steps = collatz(k);
+    if (steps > longest) {
+        longest = steps;
+    }
+}
+
+print(sumTo(20000), longest);
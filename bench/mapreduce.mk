@@ -0,0 +1,53 @@
+# array map/filter/reduce implemented by recursion over rest()
+let map = fn(arr, f) {
+    let iter = fn(arr, acc) {
+        if (len(arr) == 0) {
+            return acc;
+        }
+        return iter(rest(arr), push(acc, f(first(arr))));
+    };
+    return iter(arr, []);
+};
+
+let filter = fn(arr, pred) {
+    let iter = fn(arr, acc) {
+        if (len(arr) == 0) {
+            return acc;
+        }
+        if (pred(first(arr))) {
+            return iter(rest(arr), push(acc, first(arr)));
+        }
+        return iter(rest(arr), acc);
+    };
+    return iter(arr, []);
+};
+
+let reduce = fn(arr, initial, f) {
+    let iter = fn(arr, result) {
+        if (len(arr) == 0) {
+            return result;
+        }
+        return iter(rest(arr), f(result, first(arr)));
+    };
+    return iter(arr, initial);
+};
+
+let range = fn(i, n, acc) {
+    if (i == n) {
+        return acc;
+    }
+    return range(i + 1, n, push(acc, i));
+};
+
+let numbers = range(0, 300, []);
+let round = fn(times, total) {
+    if (times == 0) {
+        return total;
+    }
+    let doubled = map(numbers, fn(x) { x * 2 });
+    let small = filter(doubled, fn(x) { x < 300 });
+    let sum = reduce(small, 0, fn(acc, x) { acc + x });
+    return round(times - 1, total + sum / 100);
+};
+
+print(round(10, 0));
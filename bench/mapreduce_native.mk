@@ -0,0 +1,20 @@
+# the same transforms as mapreduce.mk with the native map/filter/reduce builtins
+let range = fn(i, n, acc) {
+    if (i == n) {
+        return acc;
+    }
+    return range(i + 1, n, push(acc, i));
+};
+
+let numbers = range(0, 300, []);
+let round = fn(times, total) {
+    if (times == 0) {
+        return total;
+    }
+    let doubled = map(numbers, fn(x) { x * 2 });
+    let small = filter(doubled, fn(x) { x < 300 });
+    let sum = reduce(small, fn(acc, x) { acc + x }, 0);
+    return round(times - 1, total + sum / 100);
+};
+
+print(round(10, 0));
@@ -0,0 +1,472 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../include/filter.h"
+#include "../include/native.h"
+#include "../include/parallel.h"
+#include "../include/repl.h"
+#include "../utils/timer.h"
+
+#ifndef MONKEY_BENCH_DIR
+#define MONKEY_BENCH_DIR "bench"
+#endif
+
+namespace {
+    struct BenchOptions {
+        int runs = 10;
+        int isolates = 0;          // > 0 时脚本只编译一次, 在这么多线程中同时运行, 每个线程运行 runs 次
+        size_t filterLines = 0;    // > 0 时以 `monkey filter` 的方式运行脚本, 输入为这么多行生成的日志
+        monkey::FilterOptions filter;
+        double threshold = 10.0;   // 相对 baseline 允许的中位数退化百分比
+        std::string baseline;
+        std::string output;
+        std::vector<std::string> paths;
+        monkey::RunOptions run;
+        std::shared_ptr<monkey::BuiltinRegistry> registry;   // --native 加载的扩展追加到这里, 即 run.builtins
+    };
+
+    struct BenchResult {
+        std::string name;
+        bool ok = false;
+        std::string error;
+        std::vector<double> samples;   // 每次运行耗时(ms)
+        double median = 0;
+        double p95 = 0;
+        double opsPerSec = 0;
+        double throughput = 0;      // --isolates: 所有线程合计每秒完成的运行次数
+        double linesPerSec = 0;     // --filter-lines: 按中位数计算的每秒处理行数
+        long peakRssKb = 0;
+        double baselineMedian = -1;
+        double changePct = 0;
+    };
+
+    void usage() {
+        std::cerr << "Usage: ./monkey_bench [--runs N] [--baseline FILE] [--output FILE] [--threshold PCT] [--vm stack|register] [-O0|-O1|-O2] [--isolates N] [--native lib.so ...] [--threads N] [--filter-lines N [--fn NAME] [--batch N] [--jobs N]] [file.mk|dir ...]" << std::endl;
+    }
+
+    std::string readFile(const std::string& path) {
+        std::ifstream input(path);
+        std::string line;
+        std::string program;
+        while (getline(input, line)) {
+            if (!line.empty() && line[0] == '#') {
+                continue;
+            }
+            program += line;
+            program += "\n";
+        }
+        return program;
+    }
+
+    bool endsWith(const std::string& s, const std::string& suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    std::string baseName(const std::string& path) {
+        auto slash = path.find_last_of('/');
+        auto name = slash == std::string::npos ? path : path.substr(slash + 1);
+        return endsWith(name, ".mk") ? name.substr(0, name.size() - 3) : name;
+    }
+
+    // 收集目录下所有 .mk 脚本
+    std::vector<std::string> collectScripts(const std::vector<std::string>& paths) {
+        std::vector<std::string> scripts;
+        for (auto& path : paths) {
+            DIR* dir = opendir(path.c_str());
+            if (dir == nullptr) {
+                scripts.push_back(path);
+                continue;
+            }
+            std::vector<std::string> found;
+            while (auto entry = readdir(dir)) {
+                std::string name = entry->d_name;
+                if (endsWith(name, ".mk")) {
+                    found.push_back(path + "/" + name);
+                }
+            }
+            closedir(dir);
+            std::sort(found.begin(), found.end());
+            scripts.insert(scripts.end(), found.begin(), found.end());
+        }
+        return scripts;
+    }
+
+    // 与 `monkey run` 相同的完整流程: lex -> parse -> compile -> run
+    void runProgram(const std::string& program, const monkey::RunOptions& options) {
+        monkey::Isolate isolate(monkey::CompileProgram(program, options));
+        isolate.Run();
+    }
+
+    // 压力测试: isolates 个线程各自运行 runs 次, 每次都从进程级编译缓存取程序, 只有第一次会编译.
+    // samples 收集每次运行的耗时 (包括查缓存), 返回所有线程完成的总耗时(ms)
+    double runIsolates(const std::string& program, int runs, int isolates, const monkey::RunOptions& options,
+                       std::vector<double>& samples) {
+        auto& cache = monkey::ProgramCache::Shared();
+        monkey::Isolate(cache.Get(program, options)).Run();    // warm-up, 同时填充缓存
+        std::vector<std::vector<double>> threadSamples(isolates);
+        std::vector<std::string> errors(isolates);
+        std::vector<std::thread> threads;
+        Timer wall;
+        for (int t = 0; t < isolates; ++t) {
+            threads.emplace_back([&, t]() {
+                try {
+                    for (int i = 0; i < runs; ++i) {
+                        Timer timer;
+                        monkey::Isolate isolate(cache.Get(program, options));
+                        isolate.Run();
+                        threadSamples[t].push_back(timer.elapsed() * 1000.0);
+                    }
+                } catch (std::exception& e) {
+                    errors[t] = e.what();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        double wallMs = wall.elapsed() * 1000.0;
+        for (int t = 0; t < isolates; ++t) {
+            if (!errors[t].empty()) {
+                throw monkey::RunningError{"isolate " + std::to_string(t) + ": " + errors[t]};
+            }
+            samples.insert(samples.end(), threadSamples[t].begin(), threadSamples[t].end());
+        }
+        return wallMs;
+    }
+
+    // 生成 lines 行访问日志写到临时文件, 返回已经删除了路径的文件描述符
+    int makeFilterInput(size_t lines) {
+        char path[] = "/tmp/monkey_filter_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0) {
+            throw monkey::RunningError{"can not create filter input"};
+        }
+        unlink(path);
+        static const char* methods[] = {"GET", "POST", "PUT", "DELETE"};
+        static const char* paths[] = {"/index.html", "/api/users", "/api/orders/42", "/static/app.js", "/login"};
+        static const char* statuses[] = {"200", "200", "200", "404", "500", "302"};
+        std::string text;
+        for (size_t i = 0; i < lines; ++i) {
+            text += "10.0.0." + std::to_string(i % 256) + " - " + methods[i % 4] + " " + paths[i % 5] + " "
+                + statuses[i % 6] + " " + std::to_string(i * 37 % 5000) + "\n";
+            if (text.size() >= (1 << 20) || i + 1 == lines) {
+                if (write(fd, text.data(), text.size()) != static_cast<ssize_t>(text.size())) {
+                    throw monkey::RunningError{"can not write filter input"};
+                }
+                text.clear();
+            }
+        }
+        return fd;
+    }
+
+    // 与 `monkey filter` 相同: 编译, 运行脚本, 再对输入的每行调用处理函数
+    void runFilter(const std::string& program, const monkey::RunOptions& options,
+                   const monkey::FilterOptions& filter, int input) {
+        if (lseek(input, 0, SEEK_SET) != 0) {
+            throw monkey::RunningError{"can not rewind filter input"};
+        }
+        monkey::RunFilter(monkey::CompileProgram(program, options), filter, input);
+        monkey::StandardOutput().Flush();
+    }
+
+    double percentile(std::vector<double> sorted, double p) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        auto rank = p * (sorted.size() - 1);
+        auto lower = static_cast<size_t>(rank);
+        auto upper = std::min(lower + 1, sorted.size() - 1);
+        return sorted[lower] + (sorted[upper] - sorted[lower]) * (rank - lower);
+    }
+
+    // 在子进程中运行脚本, 以便独立统计每个基准的峰值 RSS
+    BenchResult runBenchmark(const std::string& path, int runs, int isolates, const monkey::RunOptions& options,
+                             size_t filterLines, const monkey::FilterOptions& filter) {
+        BenchResult result;
+        result.name = baseName(path);
+        auto program = readFile(path);
+
+        int fds[2];
+        if (pipe(fds) != 0) {
+            result.error = "pipe failed";
+            return result;
+        }
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid < 0) {
+            result.error = "fork failed";
+            return result;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            // 丢弃脚本自身的输出
+            int devnull = open("/dev/null", O_WRONLY);
+            dup2(devnull, STDOUT_FILENO);
+            int status = 0;
+            try {
+                int input = filterLines > 0 ? makeFilterInput(filterLines) : -1;
+                auto run = [&]() {
+                    if (input >= 0) {
+                        runFilter(program, options, filter, input);
+                    } else {
+                        runProgram(program, options);
+                    }
+                };
+                if (isolates > 0) {
+                    // 先写所有样本, 最后写总耗时
+                    std::vector<double> samples;
+                    double wallMs = runIsolates(program, runs, isolates, options, samples);
+                    samples.push_back(wallMs);
+                    auto bytes = samples.size() * sizeof(double);
+                    if (write(fds[1], samples.data(), bytes) != static_cast<ssize_t>(bytes)) {
+                        status = 3;
+                    }
+                    runs = 0;
+                } else {
+                    run();   // warm-up
+                }
+                for (int i = 0; i < runs; ++i) {
+                    Timer timer;
+                    run();
+                    double ms = timer.elapsed() * 1000.0;
+                    if (write(fds[1], &ms, sizeof(ms)) != sizeof(ms)) {
+                        status = 3;
+                        break;
+                    }
+                }
+            } catch (std::exception& e) {
+                std::cerr << result.name << ": " << e.what();
+                status = 2;
+            }
+            monkey::StandardOutput().Flush();
+            std::cout.flush();
+            close(fds[1]);
+            _exit(status);
+        }
+
+        close(fds[1]);
+        double ms;
+        while (read(fds[0], &ms, sizeof(ms)) == sizeof(ms)) {
+            result.samples.push_back(ms);
+        }
+        close(fds[0]);
+
+        int status = 0;
+        struct rusage usage;
+        wait4(pid, &status, 0, &usage);
+        int expected = isolates > 0 ? runs * isolates + 1 : runs;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || static_cast<int>(result.samples.size()) != expected) {
+            result.error = "benchmark process failed";
+            return result;
+        }
+        if (isolates > 0) {
+            double wallMs = result.samples.back();
+            result.samples.pop_back();
+            result.throughput = wallMs > 0 ? result.samples.size() * 1000.0 / wallMs : 0;
+        }
+
+        std::sort(result.samples.begin(), result.samples.end());
+        result.ok = true;
+        result.median = percentile(result.samples, 0.5);
+        result.p95 = percentile(result.samples, 0.95);
+        result.opsPerSec = result.median > 0 ? 1000.0 / result.median : 0;
+        if (filterLines > 0 && isolates == 0) {
+            result.linesPerSec = result.median > 0 ? filterLines * 1000.0 / result.median : 0;
+        }
+        result.peakRssKb = usage.ru_maxrss;
+        return result;
+    }
+
+    std::string jsonEscape(const std::string& s) {
+        std::string out;
+        for (auto c : s) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out;
+    }
+
+    std::string toJson(const std::vector<BenchResult>& results, int runs, int isolates) {
+        std::stringstream out;
+        out << std::fixed << std::setprecision(3);
+        out << "{\n  \"runs\": " << runs << ",\n";
+        if (isolates > 0) {
+            out << "  \"isolates\": " << isolates << ",\n";
+        }
+        out << "  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            auto& r = results[i];
+            out << "    {\"name\": \"" << jsonEscape(r.name) << "\", ";
+            if (!r.ok) {
+                out << "\"error\": \"" << jsonEscape(r.error) << "\"}";
+            } else {
+                out << "\"median_ms\": " << r.median << ", "
+                    << "\"p95_ms\": " << r.p95 << ", "
+                    << "\"ops_per_sec\": " << r.opsPerSec << ", "
+                    << "\"peak_rss_kb\": " << r.peakRssKb;
+                if (r.linesPerSec > 0) {
+                    out << ", \"lines_per_sec\": " << r.linesPerSec;
+                }
+                if (r.throughput > 0) {
+                    out << ", \"throughput_per_sec\": " << r.throughput;
+                }
+                if (r.baselineMedian >= 0) {
+                    out << ", \"baseline_median_ms\": " << r.baselineMedian
+                        << ", \"change_pct\": " << r.changePct;
+                }
+                out << "}";
+            }
+            out << (i + 1 == results.size() ? "\n" : ",\n");
+        }
+        out << "  ]\n}\n";
+        return out.str();
+    }
+
+    // 读取之前保存的结果, 每个基准占一行, 只需要 name 和 median_ms
+    std::map<std::string, double> loadBaseline(const std::string& path) {
+        std::map<std::string, double> baseline;
+        std::ifstream input(path);
+        std::string line;
+        while (getline(input, line)) {
+            auto namePos = line.find("\"name\": \"");
+            auto medianPos = line.find("\"median_ms\": ");
+            if (namePos == std::string::npos || medianPos == std::string::npos) {
+                continue;
+            }
+            namePos += std::strlen("\"name\": \"");
+            auto nameEnd = line.find('"', namePos);
+            auto name = line.substr(namePos, nameEnd - namePos);
+            baseline[name] = std::atof(line.c_str() + medianPos + std::strlen("\"median_ms\": "));
+        }
+        return baseline;
+    }
+
+    bool parseOptions(int argc, char* argv[], BenchOptions& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg(argv[i]);
+            bool hasValue = i + 1 < argc;
+            if (arg == "--runs" && hasValue) {
+                options.runs = std::atoi(argv[++i]);
+            } else if (arg == "--baseline" && hasValue) {
+                options.baseline = argv[++i];
+            } else if (arg == "--output" && hasValue) {
+                options.output = argv[++i];
+            } else if (arg == "--isolates" && hasValue) {
+                options.isolates = std::atoi(argv[++i]);
+                if (options.isolates <= 0) {
+                    return false;
+                }
+            } else if (arg == "--filter-lines" && hasValue) {
+                options.filterLines = std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--fn" && hasValue) {
+                options.filter.function = argv[++i];
+            } else if (arg == "--batch" && hasValue) {
+                options.filter.batch = std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--jobs" && hasValue) {
+                options.filter.jobs = std::strtoul(argv[++i], nullptr, 10);
+            } else if (arg == "--threshold" && hasValue) {
+                options.threshold = std::atof(argv[++i]);
+            } else if (arg == "--vm" && hasValue) {
+                std::string vm(argv[++i]);
+                if (vm == "register") {
+                    options.run.backend = monkey::Backend::Register;
+                } else if (vm != "stack") {
+                    return false;
+                }
+            } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+                options.run.optimizeLevel = arg[2] - '0';
+            } else if (arg == "--native" && hasValue) {
+                if (options.run.builtins == nullptr) {
+                    options.registry = std::make_shared<monkey::BuiltinRegistry>();
+                    options.run.builtins = options.registry;
+                }
+                try {
+                    monkey::LoadNativeExtension(*options.registry, argv[++i]);
+                } catch (std::exception& e) {
+                    std::cerr << e.what();
+                    return false;
+                }
+            } else if (arg == "--threads" && hasValue) {
+                monkey::SetParallelWorkers(std::atoi(argv[++i]));
+            } else if (!arg.empty() && arg[0] == '-') {
+                return false;
+            } else {
+                options.paths.push_back(arg);
+            }
+        }
+        if (options.paths.empty()) {
+            options.paths.push_back(options.filterLines > 0 ? MONKEY_BENCH_DIR "/filter" : MONKEY_BENCH_DIR);
+        }
+        return options.runs > 0 && (options.filterLines == 0 || options.isolates == 0);
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    auto scripts = collectScripts(options.paths);
+    if (scripts.empty()) {
+        std::cerr << "no benchmark scripts found" << std::endl;
+        return 1;
+    }
+
+    std::map<std::string, double> baseline;
+    if (!options.baseline.empty()) {
+        baseline = loadBaseline(options.baseline);
+    }
+
+    std::vector<BenchResult> results;
+    bool failed = false;
+    bool regressed = false;
+    for (auto& script : scripts) {
+        auto result = runBenchmark(script, options.runs, options.isolates, options.run, options.filterLines, options.filter);
+        if (!result.ok) {
+            failed = true;
+            std::cerr << "\033[31m" << result.name << ": " << result.error << "\033[0m" << std::endl;
+        } else {
+            auto it = baseline.find(result.name);
+            if (it != baseline.end() && it->second > 0) {
+                result.baselineMedian = it->second;
+                result.changePct = (result.median - it->second) / it->second * 100.0;
+                if (result.changePct > options.threshold) {
+                    regressed = true;
+                    std::cerr << "\033[31m" << result.name << ": median regressed by " << result.changePct << "%\033[0m" << std::endl;
+                }
+            }
+        }
+        results.push_back(result);
+    }
+
+    auto json = toJson(results, options.runs, options.isolates);
+    std::cout << json;
+    if (!options.output.empty()) {
+        std::ofstream output(options.output);
+        output << json;
+    }
+    if (failed) {
+        return 2;
+    }
+    return regressed ? 3 : 0;
+}
@@ -0,0 +1,9 @@
+# recursive fibonacci in monkey, compare with fib_native.mk
+let fib = fn(n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+};
+
+print(fib(22));
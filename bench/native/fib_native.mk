@@ -0,0 +1,2 @@
+# the same recursive fibonacci from the native extension (--native libmonkey_numeric.so)
+print(native_fib(22));
@@ -0,0 +1,52 @@
+// 原生扩展示例: 与 bench/native 中纯 monkey 实现对应的 C++ 版本
+// 构建后得到 libmonkey_numeric.so, 用法: ./monkey run --native=./libmonkey_numeric.so
+#include "../../include/native.h"
+
+namespace {
+    int64_t fib(int64_t n) {
+        return n < 2 ? n : fib(n - 1) + fib(n - 2);
+    }
+
+    // native_fib(n): 与 fib.mk 相同的递归算法
+    std::shared_ptr<monkey::Object> nativeFib(monkey::ArgsView args) {
+        auto n = dynamic_cast<monkey::Integer*>(args[0].get());
+        if (n == nullptr) {
+            return std::make_shared<monkey::Error>("argument to `native_fib` must be INTEGER, got " + args[0]->type());
+        }
+        return std::make_shared<monkey::Integer>(fib(n->value));
+    }
+
+    // native_sum(array): 整数数组求和
+    std::shared_ptr<monkey::Object> nativeSum(monkey::ArgsView args) {
+        auto arr = dynamic_cast<monkey::Array*>(args[0].get());
+        if (arr == nullptr) {
+            return std::make_shared<monkey::Error>("argument to `native_sum` must be ARRAY, got " + args[0]->type());
+        }
+        // 整数数组是紧凑存储的 (Array::packed)
+        if (arr->packed) {
+            int64_t total = 0;
+            for (auto value : arr->ints) {
+                total += value;
+            }
+            return std::make_shared<monkey::Integer>(total);
+        }
+        int64_t total = 0;
+        for (auto& e : arr->elements) {
+            auto integer = dynamic_cast<monkey::Integer*>(e.get());
+            if (integer == nullptr) {
+                return std::make_shared<monkey::Error>("`native_sum` expects INTEGER elements, got " + e->type());
+            }
+            total += integer->value;
+        }
+        return std::make_shared<monkey::Integer>(total);
+    }
+} // namespace
+
+extern "C" int monkey_native_init(monkey::BuiltinRegistry* registry, int abi) {
+    if (abi != MONKEY_NATIVE_ABI) {
+        return -1;
+    }
+    registry->Register("native_fib", nativeFib, 1, true);
+    registry->Register("native_sum", nativeSum, 1, true);
+    return 0;
+}
@@ -0,0 +1,23 @@
+# summing an integer array in monkey, compare with sum_native.mk
+let sum = fn(arr) {
+    let total = 0;
+    for (let i = 0; i < len(arr); i = i + 1) {
+        total = total + arr[i];
+    }
+    total
+};
+
+let build = fn(n) {
+    let arr = [];
+    for (let i = 0; i < n; i = i + 1) {
+        arr = push(arr, i);
+    }
+    arr
+};
+
+let arr = build(1000);
+let total = 0;
+for (let k = 0; k < 100; k = k + 1) {
+    total = total + sum(arr);
+}
+print(total);
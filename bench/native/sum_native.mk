@@ -0,0 +1,15 @@
+# the same sums with native_sum from the native extension (--native libmonkey_numeric.so)
+let build = fn(n) {
+    let arr = [];
+    for (let i = 0; i < n; i = i + 1) {
+        arr = push(arr, i);
+    }
+    arr
+};
+
+let arr = build(1000);
+let total = 0;
+for (let k = 0; k < 100; k = k + 1) {
+    total = total + native_sum(arr);
+}
+print(total);
@@ -0,0 +1,18 @@
+# mapreduce_native.mk's workload with a heavier callback, on the parallel pmap/preduce builtins
+let range = fn(i, n, acc) {
+    if (i == n) {
+        return acc;
+    }
+    return range(i + 1, n, push(acc, i));
+};
+
+let fib = fn(n) {
+    if (n < 2) {
+        return n;
+    }
+    fib(n - 1) + fib(n - 2)
+};
+
+let numbers = range(0, 300, []);
+let scores = pmap(numbers, fn(x) { fib(x - x / 8 * 8 + 6) });
+print(preduce(scores, fn(acc, x) { acc + x }, 0));
@@ -0,0 +1,13 @@
+# pmap over an array of closures that write a global: the elements are checked too, so this runs serially and g ends at 8192
+let g = 0;
+let inc = fn(x) { g = g + 1; x };
+let grow = fn(a, times) {
+    if (times == 0) {
+        return a;
+    }
+    return grow(concat(a, a), times - 1);
+};
+let fs = grow([inc], 12);
+let ones = pmap(fs, fn(f) { f(1) });
+let total = preduce(fs, fn(acc, f) { acc + f(1) }, 0);
+print(len(ones), total, g);
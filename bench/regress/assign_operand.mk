@@ -0,0 +1,11 @@
+# a later operand assigns a local that an earlier operand read: both backends print 6 1 false 16 15
+let f = fn() { let x = 1; x + (if (true) { x = 5; x } else { 0 }) };
+print(f());
+let g = fn() { let a = [1, 2, 3]; let i = 0; a[(if (true) { a = [7, 8, 9]; 0 } else { 0 })] + i };
+print(g());
+let h = fn() { let x = 1; (if (true) { x = 5; x } else { 0 }) < x };
+print(h());
+let k = fn() { let x = 2; let y = 3; x * y + (if (true) { y = 10; y } else { 0 }) };
+print(k());
+let loop = fn() { let s = 0; let i = 0; while (i < 5) { s = s + (if (true) { i = i + 1; i } else { 0 }); } s };
+print(loop());
@@ -0,0 +1,2 @@
+# booleans from builtins are the shared true/false: both backends print "true true false true false false" (without --stats)
+print(!stats()["enabled"], stats()["enabled"] == false, !true, !false, !0, !"");
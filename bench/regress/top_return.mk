@@ -0,0 +1,6 @@
+# a top-level return ends the program on both backends: prints 1, then "6 1"
+print(1);
+let f = fn(x) { if (x > 1) { return x * 2; } x };
+print(f(3), f(1));
+if (true) { return 2; }
+print(3);
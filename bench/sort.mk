@@ -0,0 +1,16 @@
+# sort 131072 pseudo-random integers, their strings, and 8192 records by a comparator
+let grow = fn(a, times) {
+    if (times == 0) {
+        return a;
+    }
+    let n = len(a);
+    return grow(concat(a, map(a, fn(x) { x + n })), times - 1);
+};
+
+let index = grow([0], 17);
+let numbers = map(index, fn(i) { (i * 7919 + 13) - (i * 7919 + 13) / 100003 * 100003 });
+let sortedNumbers = sort(numbers);
+let sortedStrings = sort(map(cut(numbers, 0, 32768), fn(x) { str(x) }));
+let records = map(cut(numbers, 0, 8192), fn(x) { {"id": x, "age": x - x / 90 * 90} });
+let byAge = sort(records, fn(a, b) { a["age"] < b["age"] });
+print(first(sortedNumbers), last(sortedNumbers), first(sortedStrings), byAge[0]["id"], last(byAge)["age"]);
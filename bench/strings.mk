@@ -0,0 +1,29 @@
+# string building: concatenation, slicing and reversal
+let build = fn(i, n, acc) {
+    if (i == n) {
+        return acc;
+    }
+    return build(i + 1, n, acc + str(i) + ",");
+};
+
+let countChar = fn(s, c, i, total) {
+    if (i == len(s)) {
+        return total;
+    }
+    if (cut(s, i, i + 1) == c) {
+        return countChar(s, c, i + 1, total + 1);
+    }
+    return countChar(s, c, i + 1, total);
+};
+
+let round = fn(times, total) {
+    if (times == 0) {
+        return total;
+    }
+    let text = build(0, 60, "");
+    let mirrored = re(text);
+    let commas = countChar(text, ",", 0, 0) + countChar(mirrored, ",", 0, 0);
+    return round(times - 1, total + commas + len(concat(text, mirrored)));
+};
+
+print(round(20, 0));
@@ -0,0 +1,35 @@
+# hash-heavy word count: hash construction, string keys and lookups
+let makeWords = fn(i, n, acc) {
+    if (i == n) {
+        return acc;
+    }
+    return makeWords(i + 1, n, push(acc, "w" + str(i)));
+};
+
+let makeCounts = fn(i, n, acc) {
+    if (i == n) {
+        return acc;
+    }
+    return makeCounts(i + 1, n, push(acc, i));
+};
+
+let vocabulary = makeWords(0, 200, []);
+let table = zip(vocabulary, makeCounts(0, 200, []));
+
+# text is the vocabulary repeated, looked up word by word
+let countText = fn(words, i, n, total) {
+    if (i == n) {
+        return total;
+    }
+    return countText(words, i + 1, n, total + table[words[i]]);
+};
+
+let repeat = fn(times, total) {
+    if (times == 0) {
+        return total;
+    }
+    return repeat(times - 1, total + countText(vocabulary, 0, len(vocabulary), 0));
+};
+
+print(repeat(60, 0));
+print(len(set(concat(vocabulary, vocabulary))));
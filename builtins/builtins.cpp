@@ -1,29 +1,30 @@
 #include "../include/builtins.h"
+#include "../include/file.h"
+#include "../include/output.h"
+#include "../include/parallel.h"
+#include "../include/vm.h"
+#include "../utils/simd.h"
 
 namespace monkey{
     // len
-    std::shared_ptr<Object> len(std::vector<std::shared_ptr<Object>> args){
-        if(args.size() != 1){
-            return std::make_shared<Error>("wrong number of arguments in builtin function(len). got=" + std::to_string(args.size()) + ", want=1");
-        } else if(args[0]->type() == "STRING"){
+    std::shared_ptr<Object> len(ArgsView args){
+        if(args[0]->type() == "STRING"){
             return std::make_shared<Integer>(static_cast<int64_t>(std::dynamic_pointer_cast<Strin>(args[0])->value.size()));
         } else if(args[0]->type() == "ARRAY"){
-            return std::make_shared<Integer>(static_cast<int64_t>(std::dynamic_pointer_cast<Array>(args[0])->elements.size()));
+            return std::make_shared<Integer>(static_cast<int64_t>(std::dynamic_pointer_cast<Array>(args[0])->size()));
         } else {
             return std::make_shared<Error>("argument to `len` not supported, got " + args[0]->type());
         }
     }
 
     // first
-    std::shared_ptr<Object> first(std::vector<std::shared_ptr<Object>> args){
-        if(args.size() != 1){
-            return std::make_shared<Error>("wrong number of arguments in builtin function(first). got=" + std::to_string(args.size()) + ", want=1");
-        } else if(args[0]->type() != "ARRAY"){
+    std::shared_ptr<Object> first(ArgsView args){
+        if(args[0]->type() != "ARRAY"){
             return std::make_shared<Error>("argument to `first` must be ARRAY, got " + args[0]->type());
         } else {
             auto arr = std::dynamic_pointer_cast<Array>(args[0]);
-            if(arr->elements.size() > 0){
-                return arr->elements[0];
+            if(arr->size() > 0){
+                return arr->at(0);
             } else {
                 return nullptr;
             }
@@ -31,15 +32,13 @@ namespace monkey{
     }
 
     // last
-    std::shared_ptr<Object> last(std::vector<std::shared_ptr<Object>> args){
-        if(args.size() != 1){
-            return std::make_shared<Error>("wrong number of arguments in builtin function(last). got=" + std::to_string(args.size()) + ", want=1");
-        } else if(args[0]->type() != "ARRAY"){
+    std::shared_ptr<Object> last(ArgsView args){
+        if(args[0]->type() != "ARRAY"){
             return std::make_shared<Error>("argument to `last` must be ARRAY, got " + args[0]->type());
         } else {
             auto arr = std::dynamic_pointer_cast<Array>(args[0]);
-            if(arr->elements.size() > 0){
-                return arr->elements[arr->elements.size() - 1];
+            if(arr->size() > 0){
+                return arr->at(arr->size() - 1);
             } else {
                 return nullptr;
             }
@@ -47,13 +46,14 @@ namespace monkey{
     }
 
     // rest 接受一个数组，返回一个新数组，新数组包含原数组除第一个元素外的所有元素
-    std::shared_ptr<Object> rest(std::vector<std::shared_ptr<Object>> args){
-        if(args.size() != 1){
-            return std::make_shared<Error>("wrong number of arguments in builtin function(rest). got=" + std::to_string(args.size()) + ", want=1");
-        } else if(args[0]->type() != "ARRAY"){
+    std::shared_ptr<Object> rest(ArgsView args){
+        if(args[0]->type() != "ARRAY"){
             return std::make_shared<Error>("argument to `rest` must be ARRAY, got " + args[0]->type());
         } else {
             auto arr = std::dynamic_pointer_cast<Array>(args[0]);
+            if(arr->packed && !arr->ints.empty()){
+                return std::make_shared<Array>(std::vector<int64_t>(arr->ints.begin() + 1, arr->ints.end()));
+            }
             if(arr->elements.size() > 0){
                 std::vector<std::shared_ptr<Object>> newElements;
                 for(int i = 1; i < arr->elements.size(); ++i){
@@ -67,47 +67,56 @@ namespace monkey{
     }
 
     // push 接受一个数组和一个元素，返回一个新数组，新数组包含原数组的所有元素和新元素
-    std::shared_ptr<Object> push(std::vector<std::shared_ptr<Object>> args){
-        if(args.size() != 2){
-            return std::make_shared<Error>("wrong number of arguments in builtin function(push). got=" + std::to_string(args.size()) + ", want=2");
-        }
+    std::shared_ptr<Object> push(ArgsView args){
         if(args[0]->type() != "ARRAY"){
             return std::make_shared<Error>("argument to `push` must be ARRAY, got " + args[0]->type());
         }
         auto arr = std::dynamic_pointer_cast<Array>(args[0]);
-        std::vector<std::shared_ptr<Object>> newElements;
-        for(int i = 0; i < arr->elements.size(); ++i){
-            newElements.push_back(arr->elements[i]);
+        auto integer = dynamic_cast<Integer*>(args[1].get());
+        if(arr->packed && integer != nullptr){
+            std::vector<int64_t> ints;
+            ints.reserve(arr->ints.size() + 1);
+            ints.insert(ints.end(), arr->ints.begin(), arr->ints.end());
+            ints.push_back(integer->value);
+            return std::make_shared<Array>(std::move(ints));
         }
+        std::vector<std::shared_ptr<Object>> newElements = arr->boxed();
         newElements.push_back(args[1]);
         return std::make_shared<Array>(newElements);
     }
 
     // puts 
-    std::shared_ptr<Object> print(std::vector<std::shared_ptr<Object>> args){
+    std::shared_ptr<Object> print(ArgsView args){
+        // 整行拼好后一次写入输出缓冲
+        thread_local std::string line;
+        line.clear();
         for(auto& arg : args){
-            std::cout << arg->inspect() << " ";
+            arg->inspectTo(line);
+            line += ' ';
         }
-        std::cout << std::endl;
+        line += '\n';
+        StandardOutput().Write(line);
         return nullptr;
     }
 
-    // transform integer to string
-    std::shared_ptr<Object> str(std::vector<std::shared_ptr<Object>> args){
-        if(args.size() != 1){
-            return std::make_shared<Error>("wrong number of arguments in builtin function(to_string). got=" + std::to_string(args.size()) + ", want=1");
-        }
-        if(args[0]->type() != "INTEGER"){
-            return std::make_shared<Error>("argument to `str` must be INTEGER, got " + args[0]->type());
+    // flush
+    std::shared_ptr<Object> flush(ArgsView args){
+        StandardOutput().Flush();
+        return nullptr;
+    }
+
+    // transform value to string
+    std::shared_ptr<Object> str(ArgsView args){
+        if(dynamic_cast<Strin*>(args[0].get())){
+            return args[0];
         }
-        return std::make_shared<Strin>(std::to_string(std::dynamic_pointer_cast<Integer>(args[0])->value));
+        std::string out;
+        args[0]->inspectTo(out);
+        return std::make_shared<Strin>(std::move(out));
     }
 
     // concat two strings or two arrays
-    std::shared_ptr<Object> concat(std::vector<std::shared_ptr<Object>> args) {
-        if (args.size() != 2) {
-            return std::make_shared<Error>("wrong number of arguments in builtin function(concat). got=" + std::to_string(args.size()) + ", want=2");
-        }
+    std::shared_ptr<Object> concat(ArgsView args) {
         if (args[0]->type() != args[1]->type()) {
             return std::make_shared<Error>("arguments to `concat` must be the same type, got " + args[0]->type() + " and " + args[1]->type());
         }
@@ -116,14 +125,16 @@ namespace monkey{
         } else if (args[0]->type() == "ARRAY") {
             auto arr1 = std::dynamic_pointer_cast<Array>(args[0]);
             auto arr2 = std::dynamic_pointer_cast<Array>(args[1]);
-            std::vector<std::shared_ptr<Object>> newElements;
-            newElements.reserve(arr1->elements.size() + arr2->elements.size());
-            for (auto& e : arr1->elements) {
-                newElements.push_back(e);
-            }
-            for (auto& e : arr2->elements) {
-                newElements.push_back(e);
+            if (arr1->packed && arr2->packed) {
+                std::vector<int64_t> ints;
+                ints.reserve(arr1->ints.size() + arr2->ints.size());
+                ints.insert(ints.end(), arr1->ints.begin(), arr1->ints.end());
+                ints.insert(ints.end(), arr2->ints.begin(), arr2->ints.end());
+                return std::make_shared<Array>(std::move(ints));
             }
+            std::vector<std::shared_ptr<Object>> newElements = arr1->boxed();
+            auto tail = arr2->boxed();
+            newElements.insert(newElements.end(), tail.begin(), tail.end());
             return std::make_shared<Array>(newElements);
         } else {
             return std::make_shared<Error>("arguments to `concat` must be STRING or ARRAY, got " + args[0]->type());
@@ -131,20 +142,17 @@ namespace monkey{
     }
 
     // zip 
-    std::shared_ptr<Object> zip(std::vector<std::shared_ptr<Object>> args) {
-        if (args.size() != 2) {
-            return std::make_shared<Error>("wrong number of arguments in builtin function(zip). got=" + std::to_string(args.size()) + ", want=2");
-        }
+    std::shared_ptr<Object> zip(ArgsView args) {
         if (args[0]->type() != "ARRAY" || args[1]->type() != "ARRAY") {
             return std::make_shared<Error>("arguments to `zip` must be ARRAY, got " + args[0]->type() + " and " + args[1]->type());
         }
         auto arr1 = std::dynamic_pointer_cast<Array>(args[0]);
         auto arr2 = std::dynamic_pointer_cast<Array>(args[1]);
         std::map<std::shared_ptr<HashKey>, std::shared_ptr<HashPair>> pairs;
-        int len = std::min(arr1->elements.size(), arr2->elements.size());
+        int len = std::min(arr1->size(), arr2->size());
         for (int i = 0; i < len; ++i) {
-            auto key = arr1->elements[i];
-            auto value = arr2->elements[i];
+            auto key = arr1->at(i);
+            auto value = arr2->at(i);
             auto pair = std::make_shared<HashPair>(key, value);
             if (key->type() != "STRING" & key->type() != "INTEGER" & key->type() != "BOOLEAN") {
                 return std::make_shared<Error>("in builtin function `zip`, unusable as hash key: " + key->inspect() + "(" + key->type() + ")");
@@ -164,16 +172,13 @@ namespace monkey{
     }
 
     // set 
-    std::shared_ptr<Object> set(std::vector<std::shared_ptr<Object>> args) {
-        if (args.size() != 1) {
-            return std::make_shared<Error>("wrong number of arguments in builtin function(set). got=" + std::to_string(args.size()) + ", want=1");
-        }
+    std::shared_ptr<Object> set(ArgsView args) {
         if (args[0]->type() != "ARRAY") {
             return std::make_shared<Error>("argument to `set` must be ARRAY, got " + args[0]->type());
         }
         auto arr = std::dynamic_pointer_cast<Array>(args[0]);
         std::map<HashKey, std::shared_ptr<Object>> map;
-        for (auto& e : arr->elements) {
+        for (auto& e : arr->boxed()) {
             if (e->type() != "STRING" & e->type() != "INTEGER" & e->type() != "BOOLEAN") {
                 return std::make_shared<Error>("in builtin function `set`, unusable as hash key: " + e->inspect() + "(" + e->type() + ")");
             }
@@ -196,15 +201,12 @@ namespace monkey{
     }
 
     // type
-    std::shared_ptr<Object> type(std::vector<std::shared_ptr<Object>> args) {
-        if (args.size() != 1) {
-            return std::make_shared<Error>("wrong number of arguments in builtin function `type`. got=" + std::to_string(args.size()) + ", want=1");
-        }
+    std::shared_ptr<Object> type(ArgsView args) {
         return std::make_shared<Strin>(args[0]->type());
     }
 
     // cut
-    std::shared_ptr<Object> cut(std::vector<std::shared_ptr<Object>> args) {
+    std::shared_ptr<Object> cut(ArgsView args) {
         auto numArgs = args.size();
         if (numArgs != 2 && numArgs != 3) {
             return std::make_shared<Error>("wrong number of arguments in builtin function `sub`. got=" + std::to_string(numArgs) + ", want=2 or 3");
@@ -239,20 +241,20 @@ namespace monkey{
                     return std::make_shared<Error>("end index out of range: " + std::to_string(end->value));
                 }
                 start_pos = start->value;
-                end_pos = end->value;
+                end_pos = std::max(end->value, start->value);   // end < start 时为空数组
             }
             return std::make_shared<Strin>(str->value.substr(start_pos, end_pos - start_pos));
         }
         if (args[0]->type() == "ARRAY") {
             auto arr = std::dynamic_pointer_cast<Array>(args[0]);
             int start_pos = 0;
-            int end_pos = arr->elements.size();
+            int end_pos = arr->size();
             if (args.size() == 2) {
                 if (args[1]->type() != "INTEGER") {
                     return std::make_shared<Error>("second argument to `sub` must be INTEGER, got " + args[1]->type());
                 }
                 auto start = std::dynamic_pointer_cast<Integer>(args[1]);
-                if (start->value < 0 || start->value >= arr->elements.size()) {
+                if (start->value < 0 || start->value >= arr->size()) {
                     return std::make_shared<Error>("start index out of range: " + std::to_string(start->value));
                 }
                 start_pos = start->value;
@@ -262,15 +264,18 @@ namespace monkey{
                     return std::make_shared<Error>("second and third arguments to `sub` must be INTEGER, got " + args[1]->type() + " and " + args[2]->type());
                 }
                 auto start = std::dynamic_pointer_cast<Integer>(args[1]);
-                if (start->value < 0 || start->value >= arr->elements.size()) {
+                if (start->value < 0 || start->value >= arr->size()) {
                     return std::make_shared<Error>("start index out of range: " + std::to_string(start->value));
                 }
                 auto end = std::dynamic_pointer_cast<Integer>(args[2]);
-                if (end->value < 0 || end->value > arr->elements.size()) {
+                if (end->value < 0 || end->value > arr->size()) {
                     return std::make_shared<Error>("end index out of range: " + std::to_string(end->value));
                 }
                 start_pos = start->value;
-                end_pos = end->value;
+                end_pos = std::max(end->value, start->value);   // end < start 时为空数组
+            }
+            if (arr->packed) {
+                return std::make_shared<Array>(std::vector<int64_t>(arr->ints.begin() + start_pos, arr->ints.begin() + end_pos));
             }
             std::vector<std::shared_ptr<Object>> newElements;
             for (int i = start_pos; i < end_pos; ++i) {
@@ -282,10 +287,7 @@ namespace monkey{
     }
 
     // reverse
-    std::shared_ptr<Object> reverse(std::vector<std::shared_ptr<Object>> args) {
-        if (args.size() != 1) {
-            return std::make_shared<Error>("wrong number of arguments in builtin function `reverse`. got=" + std::to_string(args.size()) + ", want=1");
-        }
+    std::shared_ptr<Object> reverse(ArgsView args) {
         if (args[0]->type() != "STRING" && args[0]->type() != "ARRAY") {
             return std::make_shared<Error>("argument to `reverse` must be STRING or ARRAY, got " + args[0]->type());
         }
@@ -297,6 +299,9 @@ namespace monkey{
         }
         if (args[0]->type() == "ARRAY") {
             auto arr = std::dynamic_pointer_cast<Array>(args[0]);
+            if (arr->packed) {
+                return std::make_shared<Array>(std::vector<int64_t>(arr->ints.rbegin(), arr->ints.rend()));
+            }
             std::vector<std::shared_ptr<Object>> reversed;
             for (int i = arr->elements.size() - 1; i >= 0; --i) {
                 reversed.push_back(arr->elements[i]);
@@ -305,4 +310,730 @@ namespace monkey{
         }
         return std::make_shared<Error>("argument to `reverse` not supported, got " + args[0]->type());
     }
+
+    // 与 VM 的条件判断相同: 只有 false 和 null 为假
+    static bool isTruthy(const std::shared_ptr<Object>& obj) {
+        if (auto b = dynamic_cast<Boolea*>(obj.get())) {
+            return b->value;
+        }
+        return dynamic_cast<Null*>(obj.get()) == nullptr;
+    }
+
+    // pmap/preduce 的公共检查: 第一个参数是数组, 并且在 VM 中调用
+    static std::shared_ptr<Object> checkIteration(ArgsView args, const std::string& name, Array*& arr) {
+        arr = dynamic_cast<Array*>(args[0].get());
+        if (arr == nullptr) {
+            return std::make_shared<Error>("first argument to `" + name + "` must be ARRAY, got " + args[0]->type());
+        }
+        if (args.caller() == nullptr) {
+            return std::make_shared<Error>("`" + name + "` can only be called from a running program");
+        }
+        return nullptr;
+    }
+
+    // map/filter/reduce/each 遍历的元素: 数组, 或者迭代器 (如 lines 返回的文件行)
+    struct Elements {
+        Array* arr = nullptr;
+        Iterator* it = nullptr;
+        size_t index = 0;
+
+        // 取下一个元素, 没有时返回 false
+        bool next(std::shared_ptr<Object>& e) {
+            if (arr != nullptr) {
+                if (index == arr->size()) {
+                    return false;
+                }
+                e = arr->at(index++);
+                return true;
+            }
+            e = it->next();
+            return e != nullptr;
+        }
+    };
+
+    // map/filter/reduce/each 的公共检查: 第一个参数是数组或迭代器, 并且在 VM 中调用
+    static std::shared_ptr<Object> checkElements(ArgsView args, const std::string& name, Elements& source) {
+        source.arr = dynamic_cast<Array*>(args[0].get());
+        source.it = dynamic_cast<Iterator*>(args[0].get());
+        if (source.arr == nullptr && source.it == nullptr) {
+            return std::make_shared<Error>("first argument to `" + name + "` must be ARRAY or ITERATOR, got " + args[0]->type());
+        }
+        if (args.caller() == nullptr) {
+            return std::make_shared<Error>("`" + name + "` can only be called from a running program");
+        }
+        return nullptr;
+    }
+
+    // map
+    std::shared_ptr<Object> map(ArgsView args) {
+        Elements source;
+        if (auto error = checkElements(args, "map", source)) {
+            return error;
+        }
+        std::vector<std::shared_ptr<Object>> elements;
+        if (source.arr != nullptr) {
+            elements.reserve(source.arr->size());
+        }
+        std::shared_ptr<Object> e;
+        while (source.next(e)) {
+            elements.push_back(args.caller()->Call(args[1], ArgsView(&e, 1)));
+        }
+        return std::make_shared<Array>(std::move(elements));
+    }
+
+    // filter
+    std::shared_ptr<Object> filter(ArgsView args) {
+        Elements source;
+        if (auto error = checkElements(args, "filter", source)) {
+            return error;
+        }
+        std::vector<std::shared_ptr<Object>> elements;
+        std::shared_ptr<Object> e;
+        while (source.next(e)) {
+            if (isTruthy(args.caller()->Call(args[1], ArgsView(&e, 1)))) {
+                elements.push_back(e);
+            }
+        }
+        return std::make_shared<Array>(std::move(elements));
+    }
+
+    // reduce
+    std::shared_ptr<Object> reduce(ArgsView args) {
+        Elements source;
+        if (auto error = checkElements(args, "reduce", source)) {
+            return error;
+        }
+        std::shared_ptr<Object> pair[2] = {args[2], nullptr};
+        while (source.next(pair[1])) {
+            pair[0] = args.caller()->Call(args[1], ArgsView(pair, 2));
+        }
+        return pair[0];
+    }
+
+    // each
+    std::shared_ptr<Object> each(ArgsView args) {
+        Elements source;
+        if (auto error = checkElements(args, "each", source)) {
+            return error;
+        }
+        std::shared_ptr<Object> e;
+        while (source.next(e)) {
+            args.caller()->Call(args[1], ArgsView(&e, 1));
+        }
+        return nullptr;
+    }
+
+    // pmap/preduce 把数组切成块交给各线程, 每个线程分到若干块, 便于窃取; 太短的数组不值得切分
+    static size_t parallelChunks(size_t size) {
+        const size_t minChunk = 64;
+        return std::min(static_cast<size_t>(ParallelWorkers()) * 8, (size + minChunk - 1) / minChunk);
+    }
+
+    // pmap
+    std::shared_ptr<Object> pmap(ArgsView args) {
+        // 迭代器只能顺序遍历
+        if (dynamic_cast<Iterator*>(args[0].get())) {
+            return map(args);
+        }
+        Array* arr;
+        if (auto error = checkIteration(args, "pmap", arr)) {
+            return error;
+        }
+        size_t size = arr->size();
+        size_t chunks = parallelChunks(size);
+        auto fn = args[1];
+        // 数组元素中的闭包等也会在工作线程中被 fn 调用, 一起检查
+        std::shared_ptr<Object> reachable[2] = {args[0], fn};
+        if (chunks <= 1 || !args.caller()->ParallelSafe(ArgsView(reachable, 2))) {
+            return map(args);
+        }
+        std::vector<std::shared_ptr<Object>> results(size);
+        ParallelFor(*args.caller(), chunks, [&](Caller& caller, size_t chunk) {
+            size_t end = (chunk + 1) * size / chunks;
+            for (size_t i = chunk * size / chunks; i < end; ++i) {
+                auto e = arr->at(i);
+                results[i] = caller.Call(fn, ArgsView(&e, 1));
+            }
+        });
+        return std::make_shared<Array>(results);
+    }
+
+    // preduce
+    std::shared_ptr<Object> preduce(ArgsView args) {
+        if (dynamic_cast<Iterator*>(args[0].get())) {
+            return reduce(args);
+        }
+        Array* arr;
+        if (auto error = checkIteration(args, "preduce", arr)) {
+            return error;
+        }
+        size_t size = arr->size();
+        size_t chunks = parallelChunks(size);
+        auto fn = args[1];
+        std::shared_ptr<Object> reachable[3] = {args[0], fn, args[2]};
+        if (chunks <= 1 || !args.caller()->ParallelSafe(ArgsView(reachable, 3))) {
+            return reduce(args);
+        }
+        // 每块从自己的第一个元素开始折叠, 最后从 init 开始按顺序合并各块的结果
+        std::vector<std::shared_ptr<Object>> partials(chunks);
+        ParallelFor(*args.caller(), chunks, [&](Caller& caller, size_t chunk) {
+            size_t begin = chunk * size / chunks;
+            size_t end = (chunk + 1) * size / chunks;
+            std::shared_ptr<Object> pair[2] = {arr->at(begin), nullptr};
+            for (size_t i = begin + 1; i < end; ++i) {
+                pair[1] = arr->at(i);
+                pair[0] = caller.Call(fn, ArgsView(pair, 2));
+            }
+            partials[chunk] = pair[0];
+        });
+        std::shared_ptr<Object> pair[2] = {args[2], nullptr};
+        for (auto& partial : partials) {
+            pair[1] = partial;
+            pair[0] = args.caller()->Call(fn, ArgsView(pair, 2));
+        }
+        return pair[0];
+    }
+
+    // 整数数组: 值的符号位取反后按无符号数做 LSD 基数排序, 每趟 8 位, 所有元素在这一位上相同的趟直接跳过
+    static void radixSort(std::vector<uint64_t>& items) {
+        std::vector<uint64_t> buffer(items.size());
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t counts[257] = {0};
+            for (auto& item : items) {
+                ++counts[((item >> shift) & 0xff) + 1];
+            }
+            if (counts[((items[0] >> shift) & 0xff) + 1] == items.size()) {
+                continue;
+            }
+            for (int i = 0; i < 256; ++i) {
+                counts[i + 1] += counts[i];
+            }
+            for (auto& item : items) {
+                buffer[counts[(item >> shift) & 0xff]++] = item;
+            }
+            items.swap(buffer);
+        }
+    }
+
+    // 带比较函数: 自底向上的归并排序. 比较函数不一致 (比如总是返回 true) 时结果无意义, 但不会越界
+    static void mergeSort(std::vector<std::shared_ptr<Object>>& elements, const std::function<bool(const std::shared_ptr<Object>&, const std::shared_ptr<Object>&)>& less) {
+        std::vector<std::shared_ptr<Object>> buffer(elements.size());
+        for (size_t width = 1; width < elements.size(); width *= 2) {
+            for (size_t lo = 0; lo < elements.size(); lo += 2 * width) {
+                size_t mid = std::min(lo + width, elements.size());
+                size_t hi = std::min(lo + 2 * width, elements.size());
+                size_t i = lo, j = mid, k = lo;
+                while (i < mid && j < hi) {
+                    // 右边严格小于左边时才先取右边, 保持稳定
+                    if (less(elements[j], elements[i])) {
+                        buffer[k++] = elements[j++];
+                    } else {
+                        buffer[k++] = elements[i++];
+                    }
+                }
+                while (i < mid) {
+                    buffer[k++] = elements[i++];
+                }
+                while (j < hi) {
+                    buffer[k++] = elements[j++];
+                }
+            }
+            elements.swap(buffer);
+        }
+    }
+
+    // sort
+    std::shared_ptr<Object> sort(ArgsView args) {
+        if (args.size() != 1 && args.size() != 2) {
+            return std::make_shared<Error>("wrong number of arguments in builtin function(sort). got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+        auto arr = dynamic_cast<Array*>(args[0].get());
+        if (arr == nullptr) {
+            return std::make_shared<Error>("first argument to `sort` must be ARRAY, got " + args[0]->type());
+        }
+        if (args.size() == 2) {
+            if (args.caller() == nullptr) {
+                return std::make_shared<Error>("`sort` with a comparator can only be called from a running program");
+            }
+            // 比较函数 fn(a, b) 返回 a 是否排在 b 之前: true/false, 或者像 C 的 cmp 一样返回负数/0/正数
+            std::shared_ptr<Object> badResult;
+            std::shared_ptr<Object> pair[2];
+            auto less = [&](const std::shared_ptr<Object>& a, const std::shared_ptr<Object>& b) {
+                pair[0] = a;
+                pair[1] = b;
+                auto result = args.caller()->Call(args[1], ArgsView(pair, 2));
+                if (auto boolean = dynamic_cast<Boolea*>(result.get())) {
+                    return boolean->value;
+                }
+                if (auto integer = dynamic_cast<Integer*>(result.get())) {
+                    return integer->value < 0;
+                }
+                if (badResult == nullptr) {
+                    badResult = result;
+                }
+                return false;
+            };
+            std::vector<std::shared_ptr<Object>> sorted = arr->boxed();
+            mergeSort(sorted, less);
+            if (badResult != nullptr) {
+                return std::make_shared<Error>("comparator of `sort` must return BOOLEAN or INTEGER, got " + badResult->type());
+            }
+            return std::make_shared<Array>(std::move(sorted));
+        }
+        if (arr->size() == 0) {
+            return std::make_shared<Array>(arr->elements);
+        }
+        if (arr->packed) {
+            const uint64_t signBit = uint64_t(1) << 63;
+            std::vector<uint64_t> items;
+            items.reserve(arr->ints.size());
+            for (auto value : arr->ints) {
+                items.push_back(static_cast<uint64_t>(value) ^ signBit);
+            }
+            radixSort(items);
+            std::vector<int64_t> sorted;
+            sorted.reserve(items.size());
+            for (auto item : items) {
+                sorted.push_back(static_cast<int64_t>(item ^ signBit));
+            }
+            return std::make_shared<Array>(std::move(sorted));
+        }
+        // 不是 packed 的数组至少有一个元素不是整数
+        auto& elements = arr->elements;
+        if (dynamic_cast<Strin*>(elements[0].get())) {
+            // 只排指针, 按字节序比较
+            std::vector<Strin*> strings;
+            strings.reserve(elements.size());
+            for (auto& e : elements) {
+                auto str = dynamic_cast<Strin*>(e.get());
+                if (str == nullptr) {
+                    return std::make_shared<Error>("`sort` without a comparator needs all INTEGER or all STRING elements, got " + e->type());
+                }
+                strings.push_back(str);
+            }
+            std::vector<uint32_t> order(elements.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                order[i] = static_cast<uint32_t>(i);
+            }
+            std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                return strings[a]->value < strings[b]->value;
+            });
+            std::vector<std::shared_ptr<Object>> sorted;
+            sorted.reserve(elements.size());
+            for (auto i : order) {
+                sorted.push_back(elements[i]);
+            }
+            return std::make_shared<Array>(std::move(sorted));
+        }
+        return std::make_shared<Error>("`sort` without a comparator needs all INTEGER or all STRING elements, got " + elements[0]->type());
+    }
+
+    // sum/min/max/dot 的公共检查: 参数是整数数组 (packed) 或空数组
+    static std::shared_ptr<Object> checkIntArray(const std::shared_ptr<Object>& arg, const std::string& name, Array*& arr) {
+        arr = dynamic_cast<Array*>(arg.get());
+        if (arr == nullptr) {
+            return std::make_shared<Error>("argument to `" + name + "` must be ARRAY, got " + arg->type());
+        }
+        if (!arr->packed) {
+            for (auto& e : arr->elements) {
+                if (dynamic_cast<Integer*>(e.get()) == nullptr) {
+                    return std::make_shared<Error>("`" + name + "` expects INTEGER elements, got " + e->type());
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // sum
+    std::shared_ptr<Object> sum(ArgsView args) {
+        Array* arr;
+        if (auto error = checkIntArray(args[0], "sum", arr)) {
+            return error;
+        }
+        return std::make_shared<Integer>(SumInt64(arr->ints.data(), arr->ints.size()));
+    }
+
+    // min
+    std::shared_ptr<Object> min(ArgsView args) {
+        Array* arr;
+        if (auto error = checkIntArray(args[0], "min", arr)) {
+            return error;
+        }
+        if (arr->ints.empty()) {
+            return nullptr;
+        }
+        return std::make_shared<Integer>(MinInt64(arr->ints.data(), arr->ints.size()));
+    }
+
+    // max
+    std::shared_ptr<Object> max(ArgsView args) {
+        Array* arr;
+        if (auto error = checkIntArray(args[0], "max", arr)) {
+            return error;
+        }
+        if (arr->ints.empty()) {
+            return nullptr;
+        }
+        return std::make_shared<Integer>(MaxInt64(arr->ints.data(), arr->ints.size()));
+    }
+
+    // dot
+    std::shared_ptr<Object> dot(ArgsView args) {
+        Array* a;
+        Array* b;
+        if (auto error = checkIntArray(args[0], "dot", a)) {
+            return error;
+        }
+        if (auto error = checkIntArray(args[1], "dot", b)) {
+            return error;
+        }
+        if (a->ints.size() != b->ints.size()) {
+            return std::make_shared<Error>("arguments to `dot` must have the same length, got " + std::to_string(a->ints.size()) + " and " + std::to_string(b->ints.size()));
+        }
+        return std::make_shared<Integer>(DotInt64(a->ints.data(), b->ints.data(), a->ints.size()));
+    }
+
+    // 字符串内置函数的参数检查: 第 index 个参数必须是字符串
+    static std::shared_ptr<Object> checkString(ArgsView args, size_t index, const std::string& name, Strin*& str) {
+        str = dynamic_cast<Strin*>(args[index].get());
+        if (str == nullptr) {
+            static const char* ordinals[] = {"first", "second", "third"};
+            return std::make_shared<Error>(std::string(ordinals[index]) + " argument to `" + name + "` must be STRING, got " + args[index]->type());
+        }
+        return nullptr;
+    }
+
+    // split
+    std::shared_ptr<Object> split(ArgsView args) {
+        if (args.size() != 1 && args.size() != 2) {
+            return std::make_shared<Error>("wrong number of arguments in builtin function `split`. got=" + std::to_string(args.size()) + ", want=1 or 2");
+        }
+        Strin* str;
+        if (auto error = checkString(args, 0, "split", str)) {
+            return error;
+        }
+        const char* s = str->value.data();
+        size_t n = str->value.size();
+        std::vector<std::shared_ptr<Object>> parts;
+        if (args.size() == 1) {
+            size_t i = SkipSpace(s, n);
+            while (i < n) {
+                size_t end = i + FindSpace(s + i, n - i);
+                parts.push_back(std::make_shared<Strin>(std::string(s + i, end - i)));
+                i = end + SkipSpace(s + end, n - end);
+            }
+            return std::make_shared<Array>(std::move(parts));
+        }
+        Strin* sep;
+        if (auto error = checkString(args, 1, "split", sep)) {
+            return error;
+        }
+        size_t m = sep->value.size();
+        if (m == 0) {
+            return std::make_shared<Error>("separator of `split` must not be empty");
+        }
+        size_t i = 0;
+        while (true) {
+            size_t at = i + FindString(s + i, n - i, sep->value.data(), m);
+            parts.push_back(std::make_shared<Strin>(std::string(s + i, std::min(at, n) - i)));
+            if (at >= n) {
+                break;
+            }
+            i = at + m;
+        }
+        return std::make_shared<Array>(std::move(parts));
+    }
+
+    // find
+    std::shared_ptr<Object> find(ArgsView args) {
+        Strin* str;
+        Strin* sub;
+        if (auto error = checkString(args, 0, "find", str)) {
+            return error;
+        }
+        if (auto error = checkString(args, 1, "find", sub)) {
+            return error;
+        }
+        auto& s = str->value;
+        if (sub->value.empty()) {
+            return std::make_shared<Integer>(0);
+        }
+        size_t at = FindString(s.data(), s.size(), sub->value.data(), sub->value.size());
+        return std::make_shared<Integer>(at < s.size() ? static_cast<int64_t>(at) : -1);
+    }
+
+    // contains
+    std::shared_ptr<Object> contains(ArgsView args) {
+        Strin* str;
+        Strin* sub;
+        if (auto error = checkString(args, 0, "contains", str)) {
+            return error;
+        }
+        if (auto error = checkString(args, 1, "contains", sub)) {
+            return error;
+        }
+        auto& s = str->value;
+        bool found = sub->value.empty() || FindString(s.data(), s.size(), sub->value.data(), sub->value.size()) < s.size();
+        return found ? True : False;
+    }
+
+    // join
+    std::shared_ptr<Object> join(ArgsView args) {
+        auto arr = dynamic_cast<Array*>(args[0].get());
+        if (arr == nullptr) {
+            return std::make_shared<Error>("first argument to `join` must be ARRAY, got " + args[0]->type());
+        }
+        Strin* sep;
+        if (auto error = checkString(args, 1, "join", sep)) {
+            return error;
+        }
+        if (arr->packed) {
+            return std::make_shared<Error>("`join` expects STRING elements, got INTEGER");
+        }
+        // 先算出总长度, 结果只分配一次
+        size_t total = arr->elements.empty() ? 0 : sep->value.size() * (arr->elements.size() - 1);
+        for (auto& e : arr->elements) {
+            auto part = dynamic_cast<Strin*>(e.get());
+            if (part == nullptr) {
+                return std::make_shared<Error>("`join` expects STRING elements, got " + e->type());
+            }
+            total += part->value.size();
+        }
+        std::string joined;
+        joined.reserve(total);
+        for (size_t i = 0; i < arr->elements.size(); ++i) {
+            if (i > 0) {
+                joined += sep->value;
+            }
+            joined += static_cast<Strin*>(arr->elements[i].get())->value;
+        }
+        return std::make_shared<Strin>(std::move(joined));
+    }
+
+    // replace
+    std::shared_ptr<Object> replace(ArgsView args) {
+        Strin* str;
+        Strin* from;
+        Strin* to;
+        if (auto error = checkString(args, 0, "replace", str)) {
+            return error;
+        }
+        if (auto error = checkString(args, 1, "replace", from)) {
+            return error;
+        }
+        if (auto error = checkString(args, 2, "replace", to)) {
+            return error;
+        }
+        size_t m = from->value.size();
+        if (m == 0) {
+            return std::make_shared<Error>("second argument to `replace` must not be empty");
+        }
+        const char* s = str->value.data();
+        size_t n = str->value.size();
+        size_t at = FindString(s, n, from->value.data(), m);
+        if (at >= n) {
+            return args[0];
+        }
+        std::string replaced;
+        replaced.reserve(n);
+        size_t i = 0;
+        while (at < n) {
+            replaced.append(s + i, at - i);
+            replaced += to->value;
+            i = at + m;
+            at = i + FindString(s + i, n - i, from->value.data(), m);
+        }
+        replaced.append(s + i, n - i);
+        return std::make_shared<Strin>(std::move(replaced));
+    }
+
+    // trim
+    std::shared_ptr<Object> trim(ArgsView args) {
+        Strin* str;
+        if (auto error = checkString(args, 0, "trim", str)) {
+            return error;
+        }
+        const char* s = str->value.data();
+        size_t n = str->value.size();
+        size_t begin = SkipSpace(s, n);
+        size_t end = n;
+        while (end > begin && IsSpaceByte(s[end - 1])) {
+            --end;
+        }
+        if (begin == 0 && end == n) {
+            return args[0];
+        }
+        return std::make_shared<Strin>(std::string(s + begin, end - begin));
+    }
+
+    // upper
+    std::shared_ptr<Object> upper(ArgsView args) {
+        Strin* str;
+        if (auto error = checkString(args, 0, "upper", str)) {
+            return error;
+        }
+        std::string converted = str->value;
+        ToUpperAscii(&converted[0], converted.size());
+        return std::make_shared<Strin>(std::move(converted));
+    }
+
+    // lower
+    std::shared_ptr<Object> lower(ArgsView args) {
+        Strin* str;
+        if (auto error = checkString(args, 0, "lower", str)) {
+            return error;
+        }
+        std::string converted = str->value;
+        ToLowerAscii(&converted[0], converted.size());
+        return std::make_shared<Strin>(std::move(converted));
+    }
+
+    // read_file
+    std::shared_ptr<Object> read_file(ArgsView args) {
+        Strin* path;
+        if (auto error = checkString(args, 0, "read_file", path)) {
+            return error;
+        }
+        std::string error;
+        auto file = MappedFile::Open(path->value, error);
+        if (file == nullptr) {
+            return std::make_shared<Error>("can not read file " + error);
+        }
+        return std::make_shared<Strin>(std::string(file->data(), file->size()));
+    }
+
+    // lines
+    std::shared_ptr<Object> lines(ArgsView args) {
+        Strin* path;
+        if (auto error = checkString(args, 0, "lines", path)) {
+            return error;
+        }
+        std::string error;
+        auto file = MappedFile::Open(path->value, error);
+        if (file == nullptr) {
+            return std::make_shared<Error>("can not read file " + error);
+        }
+        return std::make_shared<LineIterator>(std::move(file));
+    }
+
+    // next
+    std::shared_ptr<Object> next(ArgsView args) {
+        auto it = dynamic_cast<Iterator*>(args[0].get());
+        if (it == nullptr) {
+            return std::make_shared<Error>("argument to `next` must be ITERATOR, got " + args[0]->type());
+        }
+        return it->next();
+    }
+
+    // 用字符串键构造 hash 对象
+    static std::shared_ptr<HashTable> makeStringHash(const std::vector<std::pair<std::string, std::shared_ptr<Object>>>& entries) {
+        std::map<std::shared_ptr<HashKey>, std::shared_ptr<HashPair>> pairs;
+        for (auto& entry : entries) {
+            auto key = std::make_shared<Strin>(entry.first);
+            pairs[key->hashKey()] = std::make_shared<HashPair>(key, entry.second);
+        }
+        return std::make_shared<HashTable>(pairs);
+    }
+
+    // stats
+    std::shared_ptr<Object> stats(ArgsView args) {
+        auto& s = runtimeStats;
+        auto micros = [](double seconds) { return std::make_shared<Integer>(static_cast<int64_t>(seconds * 1e6)); };
+        std::vector<std::pair<std::string, std::shared_ptr<Object>>> allocations;
+        for (int i = 0; i < OBJECT_KIND_COUNT; ++i) {
+            allocations.emplace_back(ObjectKindNames[i], std::make_shared<Integer>(static_cast<int64_t>(s.allocations[i])));
+        }
+        std::vector<std::pair<std::string, std::shared_ptr<Object>>> calls;
+        for (auto& call : s.builtinCalls) {
+            calls.emplace_back(call.first, std::make_shared<Integer>(static_cast<int64_t>(call.second)));
+        }
+        return makeStringHash({
+            {"enabled", s.enabled ? True : False},
+            {"lex_us", micros(s.lexTime)},
+            {"parse_us", micros(s.parseTime)},
+            {"compile_us", micros(s.compileTime)},
+            {"execute_us", micros(s.currentExecuteTime())},
+            {"tokens", std::make_shared<Integer>(static_cast<int64_t>(s.tokens))},
+            {"bytecode_bytes", std::make_shared<Integer>(static_cast<int64_t>(s.bytecodeSize))},
+            {"constants", std::make_shared<Integer>(static_cast<int64_t>(s.constantsSize))},
+            {"peak_stack", std::make_shared<Integer>(s.peakStackDepth)},
+            {"peak_frames", std::make_shared<Integer>(s.peakFrameDepth)},
+            {"instructions", std::make_shared<Integer>(static_cast<int64_t>(s.instructionsExecuted))},
+            {"allocations", makeStringHash(allocations)},
+            {"builtin_calls", makeStringHash(calls)},
+        });
+    }
+
+    // 参数个数固定的函数由 Builtin::call 统一检查
+    const std::vector<BuiltinUnit> builtins = {
+        BuiltinUnit("len", std::make_shared<Builtin>(len, 1, true)),
+        BuiltinUnit("first", std::make_shared<Builtin>(first, 1, true)),
+        BuiltinUnit("last", std::make_shared<Builtin>(last, 1, true)),
+        BuiltinUnit("rest", std::make_shared<Builtin>(rest, 1, true)),
+        BuiltinUnit("push", std::make_shared<Builtin>(push, 2, true)),
+        BuiltinUnit("print", std::make_shared<Builtin>(print)),
+        BuiltinUnit("str", std::make_shared<Builtin>(str, 1, true)),
+        BuiltinUnit("concat", std::make_shared<Builtin>(concat, 2, true)),
+        BuiltinUnit("zip", std::make_shared<Builtin>(zip, 2, true)),
+        BuiltinUnit("set", std::make_shared<Builtin>(set, 1, true)),
+        BuiltinUnit("type", std::make_shared<Builtin>(type, 1, true)),
+        BuiltinUnit("cut", std::make_shared<Builtin>(cut, -1, true)),
+        BuiltinUnit("re", std::make_shared<Builtin>(reverse, 1, true)),
+        BuiltinUnit("stats", std::make_shared<Builtin>(stats, 0)),
+        BuiltinUnit("map", std::make_shared<Builtin>(map, 2)),
+        BuiltinUnit("filter", std::make_shared<Builtin>(filter, 2)),
+        BuiltinUnit("reduce", std::make_shared<Builtin>(reduce, 3)),
+        BuiltinUnit("each", std::make_shared<Builtin>(each, 2)),
+        BuiltinUnit("pmap", std::make_shared<Builtin>(pmap, 2)),
+        BuiltinUnit("preduce", std::make_shared<Builtin>(preduce, 3)),
+        BuiltinUnit("sort", std::make_shared<Builtin>(sort)),
+        BuiltinUnit("sum", std::make_shared<Builtin>(sum, 1, true)),
+        BuiltinUnit("min", std::make_shared<Builtin>(min, 1, true)),
+        BuiltinUnit("max", std::make_shared<Builtin>(max, 1, true)),
+        BuiltinUnit("dot", std::make_shared<Builtin>(dot, 2, true)),
+        BuiltinUnit("split", std::make_shared<Builtin>(split, -1, true)),
+        BuiltinUnit("find", std::make_shared<Builtin>(find, 2, true)),
+        BuiltinUnit("contains", std::make_shared<Builtin>(contains, 2, true)),
+        BuiltinUnit("join", std::make_shared<Builtin>(join, 2, true)),
+        BuiltinUnit("replace", std::make_shared<Builtin>(replace, 3, true)),
+        BuiltinUnit("trim", std::make_shared<Builtin>(trim, 1, true)),
+        BuiltinUnit("upper", std::make_shared<Builtin>(upper, 1, true)),
+        BuiltinUnit("lower", std::make_shared<Builtin>(lower, 1, true)),
+        BuiltinUnit("flush", std::make_shared<Builtin>(flush, 0)),
+        BuiltinUnit("read_file", std::make_shared<Builtin>(read_file, 1)),
+        BuiltinUnit("lines", std::make_shared<Builtin>(lines, 1)),
+        BuiltinUnit("next", std::make_shared<Builtin>(next, 1)),
+    };
+
+    int BuiltinRegistry::Register(const std::string& name, Builtin::builtin_function fn, int arity, bool pure) {
+        if (Find(name) >= 0) {
+            throw CompileError{"builtin function " + name + " is already registered"};
+        }
+        // OpGetBuiltin 的操作数只有一个字节
+        if (units.size() > UINT8_MAX) {
+            throw CompileError{"too many builtin functions, can not register " + name};
+        }
+        units.emplace_back(name, std::make_shared<Builtin>(fn, arity, pure));
+        return units.size() - 1;
+    }
+
+    int BuiltinRegistry::Find(const std::string& name) const {
+        for (size_t i = 0; i < units.size(); ++i) {
+            if (units[i].name == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void BuiltinRegistry::DefineIn(SymbolTable& symbolTable) const {
+        for (size_t i = 0; i < units.size(); ++i) {
+            symbolTable.DefineBuiltin(i, units[i].name);
+        }
+    }
+
+    std::shared_ptr<const BuiltinRegistry> BuiltinRegistry::Default() {
+        static const std::shared_ptr<const BuiltinRegistry> registry = std::make_shared<BuiltinRegistry>();
+        return registry;
+    }
 };
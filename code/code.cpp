@@ -1,6 +1,40 @@
 #include "../include/code.h"
 
 namespace monkey {
+    const std::map<Opcode, Defination> definations = {
+        {OpConstant, {"OpConstant", {2}}},
+        {OpPop, {"OpPop", {}}},
+        {OpAdd, {"OpAdd", {}}},
+        {OpSub, {"OpSub", {}}},
+        {OpMul, {"OpMul", {}}},
+        {OpDiv, {"OpDiv", {}}},
+        {OpTrue, {"OpTrue", {}}},
+        {OpFalse, {"OpFalse", {}}},
+        {OpEqual, {"OpEqual", {}}},
+        {OpNotEqual, {"OpNotEqual", {}}},
+        {OpGreaterThan, {"OpGreaterThan", {}}},
+        {OpMinus, {"OpMinus", {}}},
+        {OpBang, {"OpBang", {}}},
+        {OpJumpNotTruthy, {"OpJumpNotTruthy", {2}}},
+        {OpJump, {"OpJump", {2}}},
+        {OpNull, {"OpNull", {}}},
+        {OpSetGlobal, {"OpSetGlobal", {2}}},
+        {OpGetGlobal, {"OpGetGlobal", {2}}},
+        {OpGetLocal, {"OpGetLocal", {1}}},
+        {OpSetLocal, {"OpSetLocal", {1}}},
+        {OpArray, {"OpArray", {2}}},
+        {OpHash, {"OpHash", {2}}},
+        {OpIndex, {"OpIndex", {}}},
+        {OpCall, {"OpCall", {1}}},
+        {OpReturnValue, {"OpReturnValue", {}}},
+        {OpReturn, {"OpReturn", {}}},
+        {OpGetBuiltin, {"OpGetBuiltin", {1}}},
+        {OpClosure, {"OpClosure", {2, 1}}},
+        {OpGetFree, {"OpGetFree", {1}}},
+        {OpCurrentClosure, {"OpCurrentClosure", {}}},
+        {OpTailCall, {"OpTailCall", {1}}},
+    };
+
     std::string InstructionsToString(Instructions &ins) {
         std::stringstream result;
         for (int i = 0; i < ins.size(); ++i) {
@@ -11,7 +45,9 @@ namespace monkey {
             auto operands = ReadOperands(def, ins, i+1);
             result << std::setw(4) << std::setfill('0') << i << " " 
                     << FmtInstruction(def, operands) << "\n";
-            i += def->OperandWidths.size();
+            for (auto width : def->OperandWidths) {
+                i += width;
+            }
         }
         return result.str();
     }
@@ -30,6 +66,9 @@ namespace monkey {
             case 1:
                 result << def->Name << " " << operands[0];
                 break;
+            case 2:
+                result << def->Name << " " << operands[0] << " " << operands[1];
+                break;
             default:
                 result << "ERROR: unhandled operandCount for " << def->Name << "\n";
                 break;
@@ -38,10 +77,11 @@ namespace monkey {
     }
 
     Instructions Make(Opcode op, std::vector<uint16_t> operands) {
-        if (definations.find(op) == definations.end()) {
+        auto it = definations.find(op);
+        if (it == definations.end()) {
             return std::vector<byte>();
         }
-        auto def = definations[op];
+        auto& def = it->second;
         Instructions ins;
         ins.emplace_back(op);
         width_t width;
@@ -86,4 +126,87 @@ namespace monkey {
         }
         return operands;
     }
-} // namespace monkey
\ No newline at end of file
+
+    int StackEffect(Opcode op, const std::vector<uint16_t>& operands) {
+        switch (op) {
+            case OpConstant:
+            case OpTrue:
+            case OpFalse:
+            case OpNull:
+            case OpGetGlobal:
+            case OpGetLocal:
+            case OpGetBuiltin:
+            case OpGetFree:
+            case OpCurrentClosure:
+                return 1;
+            case OpPop:
+            case OpAdd:
+            case OpSub:
+            case OpMul:
+            case OpDiv:
+            case OpEqual:
+            case OpNotEqual:
+            case OpGreaterThan:
+            case OpJumpNotTruthy:
+            case OpSetGlobal:
+            case OpSetLocal:
+            case OpIndex:
+            case OpReturnValue:
+                return -1;
+            case OpArray:
+                return 1 - operands[0];
+            case OpHash:
+                return 1 - 2 * operands[0];
+            case OpCall:
+            case OpTailCall:
+                // 被调函数和实参出栈, 返回值入栈
+                return -operands[0];
+            case OpClosure:
+                return 1 - operands[1];
+            default:
+                return 0;
+        }
+    }
+
+    int MaxStackDepth(Instructions &ins) {
+        // 沿控制流传播每条指令入口处的栈深度, 每个位置只处理一次 (编译器生成的代码在汇合点深度一致)
+        std::vector<int> depthAt(ins.size() + 1, -1);
+        std::vector<int> worklist;
+        int maxDepth = 0;
+        auto visit = [&](int offset, int depth) {
+            if (offset < static_cast<int>(depthAt.size()) && depthAt[offset] < 0) {
+                depthAt[offset] = depth;
+                worklist.push_back(offset);
+            }
+        };
+        visit(0, 0);
+        while (!worklist.empty()) {
+            int offset = worklist.back();
+            worklist.pop_back();
+            if (offset >= static_cast<int>(ins.size())) {
+                continue;
+            }
+            auto def = Lookup(ins[offset]);
+            if (def == nullptr) {
+                throw CodeError{"Unknown opcode in 'MaxStackDepth()'\n"};
+            }
+            auto op = ins[offset];
+            auto operands = ReadOperands(def, ins, offset + 1);
+            int depth = depthAt[offset] + StackEffect(op, operands);
+            if (depth > maxDepth) {
+                maxDepth = depth;
+            }
+            int next = offset + 1;
+            for (auto width : def->OperandWidths) {
+                next += width;
+            }
+            if (op == OpJump || op == OpJumpNotTruthy) {
+                visit(operands[0], depth);
+            }
+            if (op != OpJump && op != OpReturnValue && op != OpReturn) {
+                visit(next, depth);
+            }
+        }
+        return maxDepth;
+    }
+} // namespace monkey
@@ -0,0 +1,63 @@
+#include <sstream>
+#include <iomanip>
+
+#include "../include/regcode.h"
+
+namespace monkey {
+    const std::map<Opcode, RegDefination> regDefinations = {
+        {ROpMove, {"ROpMove", 2}},
+        {ROpLoadConstant, {"ROpLoadConstant", 2}},
+        {ROpLoadTrue, {"ROpLoadTrue", 1}},
+        {ROpLoadFalse, {"ROpLoadFalse", 1}},
+        {ROpLoadNull, {"ROpLoadNull", 1}},
+        {ROpGetGlobal, {"ROpGetGlobal", 2}},
+        {ROpSetGlobal, {"ROpSetGlobal", 2}},
+        {ROpGetBuiltin, {"ROpGetBuiltin", 2}},
+        {ROpGetFree, {"ROpGetFree", 2}},
+        {ROpCurrentClosure, {"ROpCurrentClosure", 1}},
+        {ROpAdd, {"ROpAdd", 3}},
+        {ROpSub, {"ROpSub", 3}},
+        {ROpMul, {"ROpMul", 3}},
+        {ROpDiv, {"ROpDiv", 3}},
+        {ROpEqual, {"ROpEqual", 3}},
+        {ROpNotEqual, {"ROpNotEqual", 3}},
+        {ROpGreaterThan, {"ROpGreaterThan", 3}},
+        {ROpMinus, {"ROpMinus", 2}},
+        {ROpBang, {"ROpBang", 2}},
+        {ROpJump, {"ROpJump", 1}},
+        {ROpJumpNotTruthy, {"ROpJumpNotTruthy", 2}},
+        {ROpArray, {"ROpArray", 3}},
+        {ROpHash, {"ROpHash", 3}},
+        {ROpIndex, {"ROpIndex", 3}},
+        {ROpCall, {"ROpCall", 3}},
+        {ROpTailCall, {"ROpTailCall", 3}},
+        {ROpReturn, {"ROpReturn", 1}},
+        {ROpReturnNull, {"ROpReturnNull", 0}},
+        {ROpClosure, {"ROpClosure", 3}},
+    };
+
+    static std::string fmtOperand(uint16_t operand) {
+        if (operand & RegConstantBit) {
+            return "K" + std::to_string(operand & ~RegConstantBit);
+        }
+        return std::to_string(operand);
+    }
+
+    std::string RegInstructionsToString(Instructions &ins) {
+        std::stringstream result;
+        for (size_t pc = 0; pc * RegInstructionSize < ins.size(); ++pc) {
+            auto instruction = ReadRegInstruction(ins.data(), pc);
+            auto it = regDefinations.find(instruction.op);
+            if (it == regDefinations.end()) {
+                throw CodeError{"Unknown opcode in 'RegInstructionsToString()'\n"};
+            }
+            result << std::setw(4) << std::setfill('0') << pc << " " << it->second.Name;
+            uint16_t operands[] = {instruction.a, instruction.b, instruction.c};
+            for (int i = 0; i < it->second.NumOperands; ++i) {
+                result << " " << fmtOperand(operands[i]);
+            }
+            result << "\n";
+        }
+        return result.str();
+    }
+} // namespace monkey
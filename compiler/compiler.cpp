@@ -2,6 +2,9 @@
 
 namespace monkey {
     void Compiler::Compile(std::shared_ptr<Node> node) {
+            // 尾位置只对直接子节点有效, 进入任何节点时都先清除
+            bool tail = tailPosition;
+            tailPosition = false;
             if (std::dynamic_pointer_cast<Program>(node)) {
                 auto program = std::dynamic_pointer_cast<Program>(node);
                 for (auto stmt : program->statements) {
@@ -18,17 +21,35 @@ namespace monkey {
                     // std::cout << "Compile: OpSetLocal " << symbol.name << "\n";  // debug
                     emit(OpSetLocal, {symbol.index});
                 }
+            } else if (std::dynamic_pointer_cast<AssignStatement>(node)) {
+                auto assign_stmt = std::dynamic_pointer_cast<AssignStatement>(node);
+                Symbol symbol;
+                if (!symbolTable->Resolve(assign_stmt->name->value, symbol)) {
+                    throw CompileError{"undefined variable " + assign_stmt->name->value};
+                }
+                if (symbol.scope != GlobalScope && symbol.scope != LocalScope) {
+                    throw CompileError{"cannot assign to " + symbol.scope + " variable " + symbol.name};
+                }
+                Compile(assign_stmt->value);
+                if (symbol.scope == GlobalScope) {
+                    emit(OpSetGlobal, {symbol.index});
+                } else {
+                    emit(OpSetLocal, {symbol.index});
+                }
             } else if (std::dynamic_pointer_cast<BlockStatement>(node)) {
                 auto block_stmt = std::dynamic_pointer_cast<BlockStatement>(node);
-                for (auto stmt : block_stmt->statements) {
-                    Compile(stmt);
+                for (size_t i = 0; i < block_stmt->statements.size(); ++i) {
+                    tailPosition = tail && i + 1 == block_stmt->statements.size();
+                    Compile(block_stmt->statements[i]);
                 }
             } else if (std::dynamic_pointer_cast<ReturnStatement>(node)) {
                 auto return_stmt = std::dynamic_pointer_cast<ReturnStatement>(node);
+                tailPosition = scopeIndex > 0;
                 Compile(return_stmt->returnValue);
                 emit(OpReturnValue);
             } else if (std::dynamic_pointer_cast<ExpressionStatement>(node)) {
                 auto expr_stmt = std::dynamic_pointer_cast<ExpressionStatement>(node);
+                tailPosition = tail;
                 Compile(expr_stmt->expression);
                 // std::cout << "Compile: OpPop\n";  // debug
                 emit(OpPop);
@@ -85,12 +106,9 @@ namespace monkey {
                 Compile(if_expr->condition);
                 // emit OpJumpNotTruthy with a dummy value
                 auto jumpNotTruthyPos = emit(OpJumpNotTruthy, {9999});
+                tailPosition = tail;
                 Compile(if_expr->consequence);
-
-                auto lastInstruction = scopes[scopeIndex].lastInstruction;
-                if (lastInstruction.op == OpPop) {
-                    removeLastInstruction();
-                }
+                keepBranchValue();
                 auto jumpPos = emit(OpJump, {9999});
                 auto afterConsequencePos = currentInstructions().size();
                 // std::cerr << "afterConsequencePos: " << afterConsequencePos << std::endl;  // debug
@@ -98,14 +116,34 @@ namespace monkey {
                 if (if_expr->alternative == nullptr) {
                     emit(OpNull);
                 } else {
+                    tailPosition = tail;
                     Compile(if_expr->alternative);
-                    if (lastInstruction.op == OpPop) {
-                        removeLastInstruction();
-                    }
+                    keepBranchValue();
                 }
                 auto afterAlternativePos = currentInstructions().size();
                 changeOperand(jumpPos, afterAlternativePos);
                 // std::cerr << "afterAlternativePos: " << afterAlternativePos << std::endl;  // debug
+            } else if (std::dynamic_pointer_cast<WhileExpression>(node)) {
+                auto while_expr = std::dynamic_pointer_cast<WhileExpression>(node);
+                auto loopStartPos = currentInstructions().size();
+                Compile(while_expr->condition);
+                auto exitJumpPos = emit(OpJumpNotTruthy, {9999});
+                Compile(while_expr->body);
+                // 向后跳转回到条件判断
+                emit(OpJump, {static_cast<int>(loopStartPos)});
+                changeOperand(exitJumpPos, currentInstructions().size());
+                emit(OpNull);
+            } else if (std::dynamic_pointer_cast<ForExpression>(node)) {
+                auto for_expr = std::dynamic_pointer_cast<ForExpression>(node);
+                Compile(for_expr->init);
+                auto loopStartPos = currentInstructions().size();
+                Compile(for_expr->condition);
+                auto exitJumpPos = emit(OpJumpNotTruthy, {9999});
+                Compile(for_expr->body);
+                Compile(for_expr->update);
+                emit(OpJump, {static_cast<int>(loopStartPos)});
+                changeOperand(exitJumpPos, currentInstructions().size());
+                emit(OpNull);
             } else if (std::dynamic_pointer_cast<Identifier>(node)) {
                 auto ident = std::dynamic_pointer_cast<Identifier>(node);
                 Symbol symbol;
@@ -165,6 +203,7 @@ namespace monkey {
                 for (auto& param : func->parameters) {
                     symbolTable->Define(param->value);
                 }
+                tailPosition = true;
                 Compile(func->body);
                 if (scopes[scopeIndex].lastInstruction.op == OpPop) {
                     replaceLastPopWithReturn();
@@ -176,19 +215,28 @@ namespace monkey {
                 auto numLocals = symbolTable->GetNumDefinitions();
                 auto numParams = func->parameters.size();
                 auto instructions = leaveScope();
-                for (auto free : freeSymbols) {
-                    loadSymbol(free);
-                }
                 auto compiledFn = std::make_shared<CompiledFunction>(instructions, numLocals, numParams);
-                auto fnIndex = addConstant(compiledFn);
-                emit(OpClosure, {fnIndex, static_cast<int>(freeSymbols.size())});
+                compiledFn->maxStackDepth = MaxStackDepth(compiledFn->instructions);
+                compiledFn->numFree = freeSymbols.size();
+                if (freeSymbols.empty()) {
+                    // 没有自由变量的函数在编译期构造好闭包, 运行时只需加载常量
+                    auto closureIndex = addConstant(std::make_shared<Closure>(compiledFn));
+                    emit(OpConstant, {closureIndex});
+                } else {
+                    for (auto free : freeSymbols) {
+                        loadSymbol(free);
+                    }
+                    auto fnIndex = addConstant(compiledFn);
+                    emit(OpClosure, {fnIndex, static_cast<int>(freeSymbols.size())});
+                }
             } else if (std::dynamic_pointer_cast<CallExpression>(node)) {
                 auto call_expr = std::dynamic_pointer_cast<CallExpression>(node);
                 Compile(call_expr->function);
                 for (auto& arg : call_expr->arguments) {
                     Compile(arg);
                 }
-                emit(OpCall, {static_cast<uint16_t>(call_expr->arguments.size())});
+                // 尾调用复用当前帧, 见 VM::executeTailCall
+                emit(tail ? OpTailCall : OpCall, {static_cast<uint16_t>(call_expr->arguments.size())});
             } else {
                 throw CompileError{"unknown node type " + node->String()};
             }
@@ -0,0 +1,57 @@
+#include "../include/monkey.h"
+
+namespace monkey {
+    namespace {
+        std::shared_ptr<ByteCode> stackBytecode(const std::shared_ptr<const CompiledProgram>& program) {
+            if (program->backend != Backend::Stack) {
+                throw RunningError{"Evaluator only runs stack bytecode"};
+            }
+            return program->bytecode;
+        }
+    } // namespace
+
+    Evaluator::Evaluator(std::shared_ptr<const CompiledProgram> program) : program(program), vm(stackBytecode(program)) {
+        // 宿主没有设置的全局变量是 null, 脚本读到时得到 monkey 的错误而不是空指针
+        for (size_t i = 0; i < program->globals.size(); ++i) {
+            vm.SetGlobal(static_cast<int>(i), MakeNull());
+        }
+    }
+
+    int Evaluator::globalIndex(const std::string& name) {
+        auto index = program->GlobalIndex(name);
+        if (index < 0) {
+            throw RunningError{"undeclared global: " + name};
+        }
+        return index;
+    }
+
+    void Evaluator::SetGlobal(const std::string& name, std::shared_ptr<Object> value) {
+        vm.SetGlobal(globalIndex(name), value);
+    }
+
+    void Evaluator::SetGlobal(int index, std::shared_ptr<Object> value) {
+        if (index < 0 || index >= vm.NumGlobals()) {
+            throw RunningError{"global index out of range: " + std::to_string(index)};
+        }
+        vm.SetGlobal(index, value);
+    }
+
+    std::shared_ptr<Object> Evaluator::GetGlobal(const std::string& name) {
+        return GetGlobal(globalIndex(name));
+    }
+
+    std::shared_ptr<Object> Evaluator::GetGlobal(int index) {
+        if (index < 0 || index >= vm.NumGlobals()) {
+            throw RunningError{"global index out of range: " + std::to_string(index)};
+        }
+        auto value = vm.GetGlobal(index);
+        return value != nullptr ? value : MakeNull();
+    }
+
+    std::shared_ptr<Object> Evaluator::Run() {
+        vm.Reset();
+        vm.Run();
+        auto value = vm.LastPoppedStackElem();
+        return value != nullptr ? value : MakeNull();
+    }
+} // namespace monkey
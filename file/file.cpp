@@ -0,0 +1,75 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/file.h"
+#include "../utils/simd.h"
+
+namespace monkey {
+    namespace {
+        // 每读完这么多字节交还一次页面
+        const size_t ReleaseStep = 16 * 1024 * 1024;
+    } // namespace
+
+    std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path, std::string& error) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            error = path + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            error = path + ": not a regular file";
+            close(fd);
+            return nullptr;
+        }
+        size_t length = static_cast<size_t>(st.st_size);
+        char* base = nullptr;
+        if (length > 0) {
+            void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                error = path + ": " + std::strerror(errno);
+                close(fd);
+                return nullptr;
+            }
+            base = static_cast<char*>(mapped);
+            madvise(base, length, MADV_SEQUENTIAL);
+        }
+        // 映射建立后不再需要文件描述符
+        close(fd);
+        return std::shared_ptr<MappedFile>(new MappedFile(base, length));
+    }
+
+    MappedFile::~MappedFile() {
+        if (base != nullptr) {
+            munmap(base, length);
+        }
+    }
+
+    void MappedFile::Release(size_t end) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        end -= end % page;
+        if (base != nullptr && end > released) {
+            madvise(base + released, end - released, MADV_DONTNEED);
+            released = end;
+        }
+    }
+
+    std::shared_ptr<Object> LineIterator::next() {
+        size_t size = file->size();
+        if (pos >= size) {
+            return nullptr;
+        }
+        const char* line = file->data() + pos;
+        size_t length = FindByte(line, size - pos, '\n');
+        size_t before = pos;
+        pos += length + 1;
+        if (pos / ReleaseStep != before / ReleaseStep) {
+            file->Release(before);
+        }
+        return std::make_shared<Strin>(std::string(line, length));
+    }
+} // namespace monkey
@@ -0,0 +1,351 @@
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#include "../include/filter.h"
+#include "../include/output.h"
+#include "../include/parallel.h"
+#include "../include/regvm.h"
+#include "../include/vm.h"
+#include "../utils/simd.h"
+
+namespace monkey {
+    namespace {
+        const size_t ReadChunk = 1 << 20;
+        const size_t LinesPerTask = 512;    // 并行时逐行模式下每个任务的行数
+        const size_t TasksPerJob = 4;       // 并行时每个工作线程最多对应的未写出任务数
+
+        // 从文件描述符成块读入, 逐行切分. 一行比缓冲区长时缓冲区加倍
+        class LineReader {
+        public:
+            explicit LineReader(int fd) : fd(fd), buffer(ReadChunk) {}
+
+            // 行不含 '\n'; 最后一行没有 '\n' 时也返回. 读完时返回 false
+            bool Next(const char*& line, size_t& length) {
+                while (true) {
+                    size_t newline = begin + FindByte(buffer.data() + begin, end - begin, '\n');
+                    if (newline < end) {
+                        line = buffer.data() + begin;
+                        length = newline - begin;
+                        begin = newline + 1;
+                        return true;
+                    }
+                    if (eof) {
+                        if (begin == end) {
+                            return false;
+                        }
+                        line = buffer.data() + begin;
+                        length = end - begin;
+                        begin = end;
+                        return true;
+                    }
+                    fill();
+                }
+            }
+
+        private:
+            void fill() {
+                // 把未完成的行移到开头, 再读入后面的空间
+                std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+                end -= begin;
+                begin = 0;
+                if (end == buffer.size()) {
+                    buffer.resize(buffer.size() * 2);
+                }
+                ssize_t n;
+                do {
+                    n = read(fd, buffer.data() + end, buffer.size() - end);
+                } while (n < 0 && errno == EINTR);
+                if (n < 0) {
+                    throw RunningError{std::string("read failed: ") + std::strerror(errno)};
+                }
+                if (n == 0) {
+                    eof = true;
+                }
+                end += n;
+            }
+
+            int fd;
+            std::vector<char> buffer;
+            size_t begin = 0;
+            size_t end = 0;
+            bool eof = false;
+        };
+
+        // 按 print 的格式追加一行, null 不输出
+        void appendResult(std::string& out, const std::shared_ptr<Object>& result) {
+            if (result == nullptr || dynamic_cast<Null*>(result.get())) {
+                return;
+            }
+            result->inspectTo(out);
+            out += '\n';
+        }
+
+        // 对一批行调用 fn, 结果追加到 out
+        void callLines(Caller& caller, const std::shared_ptr<Object>& fn, bool batch,
+                       std::vector<std::shared_ptr<Object>>& lines, std::string& out) {
+            if (!batch) {
+                for (auto& line : lines) {
+                    appendResult(out, caller.Call(fn, ArgsView(&line, 1)));
+                }
+                return;
+            }
+            std::shared_ptr<Object> arg = std::make_shared<Array>(std::move(lines));
+            auto result = caller.Call(fn, ArgsView(&arg, 1));
+            if (auto arr = dynamic_cast<Array*>(result.get())) {
+                for (size_t i = 0; i < arr->size(); ++i) {
+                    appendResult(out, arr->at(i));
+                }
+            } else {
+                appendResult(out, result);
+            }
+        }
+
+        // 并行过滤的一个任务: 连续的若干行和它们的输出
+        struct Task {
+            size_t seq = 0;
+            std::string text;           // 各行首尾相接
+            std::vector<size_t> ends;   // 每行在 text 中的结束位置
+            std::string out;
+        };
+
+        // 读入线程按顺序提交任务, jobs 个工作线程各用一个工作 VM 处理.
+        // 完成的任务先放进重排缓冲, 按提交顺序写出; 未写出的任务不超过 jobs * TasksPerJob 个
+        class ParallelFilter {
+        public:
+            ParallelFilter(Caller& vm, std::shared_ptr<Object> fn, bool batch, size_t jobs)
+                : fn(fn), batch(batch), limit(jobs * TasksPerJob) {
+                for (size_t i = 0; i < jobs; ++i) {
+                    auto worker = vm.NewWorker();
+                    if (worker == nullptr) {
+                        break;
+                    }
+                    workers.push_back(std::move(worker));
+                }
+                for (auto& worker : workers) {
+                    Caller* caller = worker.get();
+                    threads.emplace_back([this, caller] { work(*caller); });
+                }
+            }
+
+            ~ParallelFilter() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    closed = true;
+                    cancelled = true;
+                }
+                ready.notify_all();
+                join();
+            }
+
+            bool Started() const { return !workers.empty(); }
+
+            // 未写出的任务太多时等待. 已有任务失败时返回 false, 不再提交
+            bool Submit(std::unique_ptr<Task> task) {
+                std::unique_lock<std::mutex> lock(mutex);
+                space.wait(lock, [this] { return error || submitted - written < limit; });
+                if (error) {
+                    return false;
+                }
+                task->seq = submitted++;
+                pending.push_back(std::move(task));
+                ready.notify_one();
+                return true;
+            }
+
+            // 等所有任务写出. 任务抛出的第一个异常在这里重新抛出
+            void Finish() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    closed = true;
+                }
+                ready.notify_all();
+                join();
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+        private:
+            void work(Caller& caller) {
+                std::vector<std::shared_ptr<Object>> lines;
+                while (true) {
+                    std::unique_ptr<Task> task;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        ready.wait(lock, [this] { return cancelled || error || !pending.empty() || closed; });
+                        if (cancelled || error || pending.empty()) {
+                            return;
+                        }
+                        task = std::move(pending.front());
+                        pending.pop_front();
+                    }
+                    try {
+                        size_t begin = 0;
+                        for (auto end : task->ends) {
+                            lines.push_back(std::make_shared<Strin>(task->text.substr(begin, end - begin)));
+                            begin = end;
+                        }
+                        callLines(caller, fn, batch, lines, task->out);
+                        lines.clear();
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        ready.notify_all();
+                        space.notify_all();
+                        return;
+                    }
+                    // 写出时持有锁, 保证按顺序
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto seq = task->seq;
+                    done[seq] = std::move(task);
+                    while (!done.empty() && done.begin()->first == written) {
+                        StandardOutput().Write(done.begin()->second->out);
+                        done.erase(done.begin());
+                        ++written;
+                        space.notify_one();
+                    }
+                }
+            }
+
+            void join() {
+                for (auto& thread : threads) {
+                    if (thread.joinable()) {
+                        thread.join();
+                    }
+                }
+            }
+
+            std::shared_ptr<Object> fn;
+            bool batch;
+            size_t limit;
+            std::vector<std::unique_ptr<Caller>> workers;
+            std::vector<std::thread> threads;
+            std::mutex mutex;
+            std::condition_variable ready;      // 有新任务或结束
+            std::condition_variable space;      // 有任务写出或失败
+            std::deque<std::unique_ptr<Task>> pending;
+            std::map<size_t, std::unique_ptr<Task>> done;   // 重排缓冲: 已完成但前面还有任务未写出
+            size_t submitted = 0;
+            size_t written = 0;
+            bool closed = false;
+            bool cancelled = false;
+            std::exception_ptr error;
+        };
+
+        // 把输入分成任务交给 ParallelFilter, 返回处理的行数
+        size_t runParallel(ParallelFilter& parallel, const FilterOptions& options, int input) {
+            LineReader reader(input);
+            size_t perTask = options.batch > 0 ? options.batch : LinesPerTask;
+            size_t count = 0;
+            std::unique_ptr<Task> task(new Task());
+            const char* data;
+            size_t length;
+            while (reader.Next(data, length)) {
+                ++count;
+                task->text.append(data, length);
+                task->ends.push_back(task->text.size());
+                if (task->ends.size() == perTask) {
+                    if (!parallel.Submit(std::move(task))) {
+                        break;
+                    }
+                    task.reset(new Task());
+                }
+            }
+            if (task != nullptr && !task->ends.empty()) {
+                parallel.Submit(std::move(task));
+            }
+            parallel.Finish();
+            return count;
+        }
+
+        std::shared_ptr<Object> globalFunction(const CompiledProgram& program, const std::string& name,
+                                               const std::function<std::shared_ptr<Object>(int)>& get) {
+            int index = program.DefinitionIndex(name);
+            auto fn = index >= 0 ? get(index) : nullptr;
+            if (dynamic_cast<Closure*>(fn.get()) == nullptr && dynamic_cast<Builtin*>(fn.get()) == nullptr) {
+                throw RunningError{"filter function " + name + " is not defined"};
+            }
+            return fn;
+        }
+
+        template <typename Machine>
+        size_t runFilter(Machine& vm, const CompiledProgram& program, const FilterOptions& options, int input) {
+            vm.Run();
+            auto get = [&](int index) { return vm.GetGlobal(index); };
+            auto fn = globalFunction(program, options.function, get);
+            auto endFn = options.end.empty() ? nullptr : globalFunction(program, options.end, get);
+
+            // 处理函数能在多个线程中同时调用时才并行, 与 pmap 的条件相同
+            size_t jobs = options.jobs > 0 ? options.jobs : static_cast<size_t>(ParallelWorkers());
+            if (jobs > 1 && vm.ParallelSafe(ArgsView(&fn, 1))) {
+                ParallelFilter parallel(vm, fn, options.batch > 0, jobs);
+                if (parallel.Started()) {
+                    size_t count = runParallel(parallel, options, input);
+                    if (endFn != nullptr) {
+                        std::string out;
+                        appendResult(out, vm.Call(endFn, ArgsView(nullptr, 0)));
+                        StandardOutput().Write(out);
+                    }
+                    return count;
+                }
+            }
+
+            // 每次调用的结果立即写入 StandardOutput() (它自己有缓冲), 与函数中 print 的输出保持顺序,
+            // 后面的行出错时前面的结果也已经写出
+            LineReader reader(input);
+            std::string out;
+            auto write = [&]() {
+                if (!out.empty()) {
+                    StandardOutput().Write(out);
+                    out.clear();
+                }
+            };
+            std::vector<std::shared_ptr<Object>> batch;
+            size_t count = 0;
+            const char* data;
+            size_t length;
+            while (reader.Next(data, length)) {
+                ++count;
+                std::shared_ptr<Object> line = std::make_shared<Strin>(std::string(data, length));
+                if (options.batch > 0) {
+                    batch.push_back(std::move(line));
+                    if (batch.size() == options.batch) {
+                        callLines(vm, fn, true, batch, out);
+                        batch.clear();
+                        write();
+                    }
+                } else {
+                    appendResult(out, vm.Call(fn, ArgsView(&line, 1)));
+                    write();
+                }
+            }
+            if (!batch.empty()) {
+                callLines(vm, fn, true, batch, out);
+                write();
+            }
+            if (endFn != nullptr) {
+                appendResult(out, vm.Call(endFn, ArgsView(nullptr, 0)));
+                write();
+            }
+            return count;
+        }
+    } // namespace
+
+    size_t RunFilter(std::shared_ptr<const CompiledProgram> program, const FilterOptions& options, int input) {
+        if (program->backend == Backend::Register) {
+            RegisterVM vm(program->bytecode);
+            return runFilter(vm, *program, options, input);
+        }
+        VM vm(program->bytecode);
+        return runFilter(vm, *program, options, input);
+    }
+} // namespace monkey
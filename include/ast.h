@@ -236,6 +236,30 @@ namespace monkey{
         }
     };
 
+    // 赋值语句: 对已定义的变量重新赋值
+    struct AssignStatement : Statement{
+        Token token; // the identifier token
+        std::shared_ptr<Identifier> name;
+        std::shared_ptr<Expression> value;
+
+        AssignStatement(const Token& token) : token(token){}
+
+        void statementNode() override{}
+        std::string TokenLiteral() override{
+            return token.getLiteral();
+        }
+        std::string String() override{
+            std::string out;
+            out += name->String();
+            out += " = ";
+            if(value != nullptr){
+                out += value->String();
+            }
+            out += ";";
+            return out;
+        }
+    };
+
     // 表达式语句
     struct ExpressionStatement : Statement{
         Token token; // the first token of the expression
@@ -349,6 +373,56 @@ namespace monkey{
         }
     };
 
+    // while 循环, 值为 null
+    struct WhileExpression : Expression{
+        Token token; // the 'while' token
+        std::shared_ptr<Expression> condition; // 循环条件
+        std::shared_ptr<BlockStatement> body; // 循环体
+
+        WhileExpression(const Token& token) : token(token){}
+
+        void expressionNode() override{}
+        std::string TokenLiteral() override{
+            return token.getLiteral();
+        }
+        std::string String() override{
+            std::string out;
+            out += "while";
+            out += condition->String();
+            out += " ";
+            out += body->String();
+            return out;
+        }
+    };
+
+    // 计数 for 循环: for (init; condition; update) { body }, 值为 null
+    struct ForExpression : Expression{
+        Token token; // the 'for' token
+        std::shared_ptr<Statement> init; // 初始化语句
+        std::shared_ptr<Expression> condition; // 循环条件
+        std::shared_ptr<Statement> update; // 每次循环后执行的语句
+        std::shared_ptr<BlockStatement> body; // 循环体
+
+        ForExpression(const Token& token) : token(token){}
+
+        void expressionNode() override{}
+        std::string TokenLiteral() override{
+            return token.getLiteral();
+        }
+        std::string String() override{
+            std::string out;
+            out += "for(";
+            out += init->String();
+            out += " ";
+            out += condition->String();
+            out += "; ";
+            out += update->String();
+            out += ") ";
+            out += body->String();
+            return out;
+        }
+    };
+
     // 函数定义字面量
     struct FunctionLiteral : Expression{
         Token token; // the 'fn' token
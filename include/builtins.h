@@ -7,68 +7,156 @@
 
 #include "./object.h"
 #include "./errors.h"
+#include "./symbol.h"
 
 namespace monkey{
     struct BuiltinUnit {
         std::string name;
         std::shared_ptr<Builtin> fn;
 
-        BuiltinUnit(std::string name, std::shared_ptr<Builtin> fn) : name(name), fn(fn) {}
+        BuiltinUnit(std::string name, std::shared_ptr<Builtin> fn) : name(name), fn(fn) {
+            fn->name = name;
+        }
     };
 
     // len 接受一个数组或字符串，返回数组的长度或字符串的长度
-    std::shared_ptr<Object> len(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> len(ArgsView args);
 
     // first 接受一个数组，返回数组的第一个元素
-    std::shared_ptr<Object> first(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> first(ArgsView args);
 
     // last 接受一个数组，返回数组的最后一个元素
-    std::shared_ptr<Object> last(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> last(ArgsView args);
 
     // rest 接受一个数组，返回一个新数组，新数组包含原数组除第一个元素外的所有元素
-    std::shared_ptr<Object> rest(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> rest(ArgsView args);
 
     // push 接受一个数组和一个元素，返回一个新数组，新数组包含原数组的所有元素和新元素
-    std::shared_ptr<Object> push(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> push(ArgsView args);
+
+    // print 打印参数, 写入 StandardOutput() 的缓冲
+    std::shared_ptr<Object> print(ArgsView args);
 
-    // print 打印参数
-    std::shared_ptr<Object> print(std::vector<std::shared_ptr<Object>> args);
+    // flush 写出 print 缓冲的内容
+    std::shared_ptr<Object> flush(ArgsView args);
 
-    // str 将参数转换为字符串
-    std::shared_ptr<Object> str(std::vector<std::shared_ptr<Object>> args);
+    // str 将参数转换为字符串 (与 print 的输出相同), 字符串原样返回
+    std::shared_ptr<Object> str(ArgsView args);
 
     // concat 连接两个字符串或数组
-    std::shared_ptr<Object> concat(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> concat(ArgsView args);
 
     // zip 接受两个数组，返回一个字典，字典的键是第一个数组的元素，值是第二个数组的元素
-    std::shared_ptr<Object> zip(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> zip(ArgsView args);
 
     // set 接受一个数组, 去重后返回
-    std::shared_ptr<Object> set(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> set(ArgsView args);
 
     // type 返回参数的类型
-    std::shared_ptr<Object> type(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> type(ArgsView args);
 
     // cut 返回字符串的子串, 或数组的子数组
-    std::shared_ptr<Object> cut(std::vector<std::shared_ptr<Object>> args);
+    std::shared_ptr<Object> cut(ArgsView args);
 
     // reverse
-    std::shared_ptr<Object> reverse(std::vector<std::shared_ptr<Object>> args);
-
-    static std::vector<BuiltinUnit> builtins = {
-        BuiltinUnit("len", std::make_shared<Builtin>(len)),
-        BuiltinUnit("first", std::make_shared<Builtin>(first)),
-        BuiltinUnit("last", std::make_shared<Builtin>(last)),
-        BuiltinUnit("rest", std::make_shared<Builtin>(rest)),
-        BuiltinUnit("push", std::make_shared<Builtin>(push)),
-        BuiltinUnit("print", std::make_shared<Builtin>(print)),
-        BuiltinUnit("str", std::make_shared<Builtin>(str)),
-        BuiltinUnit("concat", std::make_shared<Builtin>(concat)),
-        BuiltinUnit("zip", std::make_shared<Builtin>(zip)),
-        BuiltinUnit("set", std::make_shared<Builtin>(set)),
-        BuiltinUnit("type", std::make_shared<Builtin>(type)),
-        BuiltinUnit("cut", std::make_shared<Builtin>(cut)),
-        BuiltinUnit("re", std::make_shared<Builtin>(reverse)),
+    std::shared_ptr<Object> reverse(ArgsView args);
+
+    // stats 返回运行时统计信息 (需要 --stats)
+    std::shared_ptr<Object> stats(ArgsView args);
+
+    // map(arr, fn) 对每个元素调用 fn, 返回结果组成的新数组. map/filter/reduce/each 的 arr 也可以是迭代器
+    std::shared_ptr<Object> map(ArgsView args);
+
+    // filter(arr, fn) 返回 fn 结果为真的元素
+    std::shared_ptr<Object> filter(ArgsView args);
+
+    // reduce(arr, fn, init) 从 init 开始依次计算 fn(acc, 元素), 返回最终的 acc
+    std::shared_ptr<Object> reduce(ArgsView args);
+
+    // each(arr, fn) 对每个元素调用 fn, 返回 null
+    std::shared_ptr<Object> each(ArgsView args);
+
+    // pmap(arr, fn) 与 map 相同, fn 不写全局变量时分块在多个线程中执行
+    std::shared_ptr<Object> pmap(ArgsView args);
+
+    // preduce(arr, fn, init) 各块并行折叠后从 init 开始按顺序合并, fn 需满足结合律; fn 写全局变量时与 reduce 相同
+    std::shared_ptr<Object> preduce(ArgsView args);
+
+    // sort(arr) 排序整数数组或字符串数组; sort(arr, fn) 用 fn(a, b) 比较任意元素. 都是稳定排序, 返回新数组
+    std::shared_ptr<Object> sort(ArgsView args);
+
+    // sum(arr) 整数数组求和
+    std::shared_ptr<Object> sum(ArgsView args);
+
+    // min(arr) 整数数组的最小值, 空数组返回 null
+    std::shared_ptr<Object> min(ArgsView args);
+
+    // max(arr) 整数数组的最大值, 空数组返回 null
+    std::shared_ptr<Object> max(ArgsView args);
+
+    // dot(a, b) 两个等长整数数组的点积
+    std::shared_ptr<Object> dot(ArgsView args);
+
+    // split(s) 按连续的空白切分, 不含空串; split(s, sep) 按 sep 切分, 保留空串
+    std::shared_ptr<Object> split(ArgsView args);
+
+    // find(s, sub) sub 第一次出现的下标, 没有时返回 -1
+    std::shared_ptr<Object> find(ArgsView args);
+
+    // contains(s, sub) s 是否包含 sub
+    std::shared_ptr<Object> contains(ArgsView args);
+
+    // join(arr, sep) 用 sep 连接字符串数组
+    std::shared_ptr<Object> join(ArgsView args);
+
+    // replace(s, old, new) 把所有不重叠的 old 替换为 new
+    std::shared_ptr<Object> replace(ArgsView args);
+
+    // trim(s) 去掉两端的空白
+    std::shared_ptr<Object> trim(ArgsView args);
+
+    // upper(s) / lower(s) 转换 ASCII 字母的大小写, 其他字节不变
+    std::shared_ptr<Object> upper(ArgsView args);
+
+    std::shared_ptr<Object> lower(ArgsView args);
+
+    // read_file(path) 读入整个文件 (mmap 后复制一次)
+    std::shared_ptr<Object> read_file(ArgsView args);
+
+    // lines(path) 返回文件各行的迭代器, 行不含 '\n'; 可以交给 map/filter/reduce/each 或逐个 next
+    std::shared_ptr<Object> lines(ArgsView args);
+
+    // next(it) 迭代器的下一个元素, 遍历完后返回 null
+    std::shared_ptr<Object> next(ArgsView args);
+
+    // 内置函数表, 下标即 OpGetBuiltin 的操作数; 进程内只有一份, 是每个 BuiltinRegistry 的初始内容
+    extern const std::vector<BuiltinUnit> builtins;
+
+    // 一个运行时可以调用的内置函数: 开头是 builtins, 宿主可以在编译前追加自己的函数.
+    // 符号表按名字解析到表中的下标, 编译出的字节码记住所用的表, VM 从同一张表取函数,
+    // 所以宿主函数和内置函数一样由 OpGetBuiltin + OpCall 调用. 注册完成后表只读, 可以被多个线程中的 VM 共享
+    class BuiltinRegistry {
+    public:
+        BuiltinRegistry() : units(builtins) {}
+
+        // 追加一个函数, 返回它的下标; arity 为 -1 时不检查参数个数. 名字已存在或表已满时抛出 CompileError
+        int Register(const std::string& name, Builtin::builtin_function fn, int arity = -1, bool pure = false);
+
+        // 没有时返回 -1
+        int Find(const std::string& name) const;
+
+        size_t Size() const { return units.size(); }
+
+        const BuiltinUnit& operator[](size_t index) const { return units[index]; }
+
+        // 把所有函数定义到 (全局) 符号表中
+        void DefineIn(SymbolTable& symbolTable) const;
+
+        // 只含 builtins 的表, 没有指定表时使用
+        static std::shared_ptr<const BuiltinRegistry> Default();
+
+    private:
+        std::vector<BuiltinUnit> units;
     };
 
 
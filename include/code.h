@@ -43,6 +43,7 @@ namespace monkey{
     const Opcode OpClosure = 27;
     const Opcode OpGetFree = 28;
     const Opcode OpCurrentClosure = 29;
+    const Opcode OpTailCall = 30;
 
     // helper function
     struct Defination {
@@ -50,46 +51,16 @@ namespace monkey{
         std::vector<width_t> OperandWidths;
     };
 
-    static std::map<Opcode, Defination> definations = {
-        {OpConstant, {"OpConstant", {2}}},
-        {OpPop, {"OpPop", {}}},
-        {OpAdd, {"OpAdd", {}}},
-        {OpSub, {"OpSub", {}}},
-        {OpMul, {"OpMul", {}}},
-        {OpDiv, {"OpDiv", {}}},
-        {OpTrue, {"OpTrue", {}}},
-        {OpFalse, {"OpFalse", {}}},
-        {OpEqual, {"OpEqual", {}}},
-        {OpNotEqual, {"OpNotEqual", {}}},
-        {OpGreaterThan, {"OpGreaterThan", {}}},
-        {OpMinus, {"OpMinus", {}}},
-        {OpBang, {"OpBang", {}}},
-        {OpJumpNotTruthy, {"OpJumpNotTruthy", {2}}},
-        {OpJump, {"OpJump", {2}}},
-        {OpNull, {"OpNull", {}}},
-        {OpSetGlobal, {"OpSetGlobal", {2}}},
-        {OpGetGlobal, {"OpGetGlobal", {2}}},
-        {OpGetLocal, {"OpGetLocal", {1}}},
-        {OpSetLocal, {"OpSetLocal", {1}}},
-        {OpArray, {"OpArray", {2}}},
-        {OpHash, {"OpHash", {2}}},
-        {OpIndex, {"OpIndex", {}}},
-        {OpCall, {"OpCall", {1}}},
-        {OpReturnValue, {"OpReturnValue", {}}},
-        {OpReturn, {"OpReturn", {}}},
-        {OpGetBuiltin, {"OpGetBuiltin", {1}}},
-        {OpClosure, {"OpClosure", {2, 1}}},
-        {OpGetFree, {"OpGetFree", {1}}},
-        {OpCurrentClosure, {"OpCurrentClosure", {}}},
-    };
+    extern const std::map<Opcode, Defination> definations;
 
     inline
     std::shared_ptr<Defination> Lookup(byte op) {
-        if (definations.find(op) == definations.end()) {
+        auto it = definations.find(op);
+        if (it == definations.end()) {
             // std::cerr << "Unknown opcode: " << op << std::endl;
             return nullptr;
         }
-        return std::make_shared<Defination>(definations[op]);
+        return std::make_shared<Defination>(it->second);
     }
 
     std::string InstructionsToString(Instructions &ins);
@@ -102,6 +73,12 @@ namespace monkey{
     // read instruction
     std::vector<uint16_t> ReadOperands(std::shared_ptr<Defination> def, Instructions &ins, offset_t init_offset);
 
+    // 指令执行后操作数栈深度的变化
+    int StackEffect(Opcode op, const std::vector<uint16_t>& operands);
+
+    // 静态计算指令序列执行时操作数栈的最大深度 (相对于局部变量之上的栈底)
+    int MaxStackDepth(Instructions &ins);
+
     inline
     void PutUint16(Instructions &ins, uint16_t val) {
         // big endian
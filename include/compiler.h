@@ -9,6 +9,11 @@ namespace monkey {
     struct ByteCode {
         Instructions instructions;
         std::shared_ptr<Constants> constants;
+        int numRegisters = 0;   // 寄存器后端: 主程序需要的寄存器数
+        int maxStackDepth = 0;  // 栈式后端: 主程序操作数栈的最大深度
+        int numGlobals = 0;     // 定义过的全局变量数, VM 按此分配全局变量表
+        bool verified = false;  // 主程序和常量池中的函数都已通过校验
+        std::shared_ptr<const BuiltinRegistry> builtins = BuiltinRegistry::Default();  // OpGetBuiltin 的下标所指的表
 
         ByteCode(Instructions ins, std::shared_ptr<Constants> cons) : instructions(ins), constants(cons) {}
     }; // struct ByteCode
@@ -32,9 +37,7 @@ namespace monkey {
             scopes.emplace_back(CompilerScope());
             constants = std::make_shared<Constants>();
             symbolTable = std::make_shared<SymbolTable>();
-            for (size_t i = 0; i < builtins.size(); ++i) {
-                symbolTable->DefineBuiltin(i, builtins[1].name);
-            }
+            BuiltinRegistry::Default()->DefineIn(*symbolTable);
         } 
         Compiler(std::shared_ptr<SymbolTable> symTable){
             scopeIndex = 0;
@@ -48,7 +51,7 @@ namespace monkey {
         std::shared_ptr<Compiler> NewWithState(std::shared_ptr<SymbolTable> symTable, std::shared_ptr<std::vector<std::shared_ptr<Object>>> constants) {
             scopeIndex = 0;
             scopes.emplace_back(CompilerScope());
-            constants = constants;
+            this->constants = constants;
             symbolTable = symTable;
             return std::make_shared<Compiler>(*this);
         }
@@ -78,6 +81,8 @@ namespace monkey {
 
         std::shared_ptr<ByteCode> Bytecode() {
             ByteCode byte_code(currentInstructions(), constants);
+            byte_code.maxStackDepth = MaxStackDepth(byte_code.instructions);
+            byte_code.numGlobals = symbolTable->GetNumDefinitions();
             return std::make_shared<ByteCode>(byte_code);
         }
 
@@ -118,7 +123,7 @@ namespace monkey {
             auto instructions = currentInstructions();
             auto previous = scopes[scopeIndex].previousInstruction;
             auto last = scopes[scopeIndex].lastInstruction;
-            instructions.reserve(last.position);
+            instructions.resize(last.position);
             scopes[scopeIndex].instructions = instructions;
             scopes[scopeIndex].lastInstruction = previous;
         }
@@ -144,6 +149,16 @@ namespace monkey {
             scopes[scopeIndex].lastInstruction.op = OpReturnValue;
         }
 
+        // if 分支的值留在栈上: 去掉最后的 OpPop, 没有值的分支补一个 null
+        void keepBranchValue() {
+            auto op = scopes[scopeIndex].lastInstruction.op;
+            if (op == OpPop) {
+                removeLastInstruction();
+            } else if (op != OpReturnValue && op != OpReturn) {
+                emit(OpNull);
+            }
+        }
+
         void loadSymbol(const Symbol& symbol) {
             auto scope = symbol.scope;
             if (scope == GlobalScope) {
@@ -161,6 +176,7 @@ namespace monkey {
 
     private:
         int scopeIndex;
+        bool tailPosition = false;  // 当前编译的表达式的值是否直接作为函数返回值
         std::vector<CompilerScope> scopes;
         std::shared_ptr<Constants> constants;
         std::shared_ptr<SymbolTable> symbolTable;
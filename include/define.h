@@ -11,7 +11,7 @@ namespace monkey {
     using byte = uint8_t;
     using Instructions = std::vector<byte>;
     using Opcode = byte;
-    using offset_t = byte;
+    using offset_t = int;   // 指令内的字节偏移, 不能用 byte, 否则超过 255 字节的指令序列会回绕
     using width_t = byte;
 
     using Constants = std::vector<std::shared_ptr<Object>>;
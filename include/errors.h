@@ -26,5 +26,9 @@ namespace monkey {
         CodeError(std::string m) : Errors("Code Error: " + m + "\n") {}
     };
 
+    struct VerifyError : public Errors {
+        VerifyError(std::string m) : Errors("Verify Error: " + m + "\n") {}
+    };
+
     
 } // namespace monkey
\ No newline at end of file
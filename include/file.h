@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "./object.h"
+
+namespace monkey {
+    // 只读映射整个文件, 析构时解除映射. 空文件不映射, data 为 nullptr
+    class MappedFile {
+    public:
+        // 打不开或映射失败时返回 nullptr, 原因写入 error
+        static std::shared_ptr<MappedFile> Open(const std::string& path, std::string& error);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return base; }
+
+        size_t size() const { return length; }
+
+        // 告诉内核 [0, end) 已经读完, 可以回收这部分页面; 之后再访问会重新从文件读入
+        void Release(size_t end);
+
+    private:
+        MappedFile(char* base, size_t length) : base(base), length(length) {}
+
+        char* base;
+        size_t length;
+        size_t released = 0;
+    };
+
+    // lines(path) 返回的迭代器: 每次 next 从映射中切出一行 (不含 '\n').
+    // 读过的部分定期交还给内核, 遍历再大的文件常驻内存也只有一小段
+    class LineIterator : public Iterator {
+    public:
+        LineIterator(std::shared_ptr<MappedFile> file) : file(std::move(file)) {}
+
+        std::shared_ptr<Object> next() override;
+
+        std::string inspect() override {
+            return "LineIterator[" + std::to_string(pos) + "/" + std::to_string(file->size()) + "]";
+        }
+
+    private:
+        std::shared_ptr<MappedFile> file;
+        size_t pos = 0;
+    };
+} // namespace monkey
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "./isolate.h"
+
+namespace monkey {
+    struct FilterOptions {
+        std::string function = "process";  // 每行 (或每批) 调用的全局函数
+        std::string end;                    // 输入结束后调用一次的全局函数, 为空时不调用
+        size_t batch = 0;                   // 大于 0 时把这么多行组成数组, 一次传给 function
+        size_t jobs = 1;                    // 处理行的线程数, 0 为 CPU 核数
+    };
+
+    // monkey filter: 先运行一遍脚本 (定义函数, 可以输出表头), 然后从 input 成块读入数据,
+    // 在同一个 VM 上对每行调用 options.function(line). 返回值不是 null 时按 print 的格式写一行到 StandardOutput();
+    // 批模式下 function 收到行的数组, 返回数组时每个元素各写一行. 行不含 '\n'.
+    // jobs > 1 且 function 满足 pmap 的并行条件时, 输入按批分给 jobs 个共享程序和全局变量的工作 VM, 输出仍按输入顺序.
+    // 返回处理的行数; 函数不存在或脚本出错时抛出异常
+    size_t RunFilter(std::shared_ptr<const CompiledProgram> program, const FilterOptions& options, int input);
+} // namespace monkey
@@ -7,7 +7,17 @@
 #include "./object.h"
 #include "./code.h"
 #include "./compiler.h"
+#include "./optimizer.h"
+#include "./verifier.h"
 #include "./define.h"
 #include "./symbol.h"
 #include "./vm.h"
-#include "./errors.h"
\ No newline at end of file
+#include "./regcode.h"
+#include "./regcompiler.h"
+#include "./regvm.h"
+#include "./isolate.h"
+#include "./errors.h"
+#include "./stats.h"
+#include "./output.h"
+#include "./file.h"
+#include "./filter.h"
\ No newline at end of file
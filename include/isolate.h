@@ -0,0 +1,106 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./compiler.h"
+#include "./optimizer.h"
+
+namespace monkey {
+    // 执行后端
+    enum class Backend {
+        Stack,      // 栈式 VM (默认)
+        Register,   // 寄存器 VM: ./monkey run --vm=register
+    };
+
+    struct RunOptions {
+        Backend backend = Backend::Stack;
+        int optimizeLevel = DefaultOptimizeLevel;   // AST 死代码删除对两种后端都生效, 窥孔优化只作用于栈式字节码
+        std::shared_ptr<const BuiltinRegistry> builtins;   // 脚本可以调用的内置函数和宿主函数, 为空时使用 BuiltinRegistry::Default()
+    };
+
+    // 编译好的程序. 编译后不再修改, 字节码, 常量池和其中的函数可以被多个线程中的 VM 同时执行
+    struct CompiledProgram {
+        std::shared_ptr<ByteCode> bytecode;
+        Backend backend;
+        std::vector<std::string> globals;   // 编译前声明的全局变量, 下标即全局变量表中的位置
+        std::map<std::string, int> definitions;     // 所有全局变量 (包括脚本顶层 let 定义的) 的下标, 同名时为最后一次定义
+
+        CompiledProgram(std::shared_ptr<ByteCode> bytecode, Backend backend, std::vector<std::string> globals)
+            : bytecode(bytecode), backend(backend), globals(globals) {}
+
+        // 声明过的全局变量的下标, 没有时返回 -1
+        int GlobalIndex(const std::string& name) const;
+
+        // 任意全局变量的下标, 没有时返回 -1
+        int DefinitionIndex(const std::string& name) const;
+    };
+
+    // lex -> parse -> compile -> 优化, 栈式字节码在返回前完成校验; 出错时抛出异常
+    // globals 中的名字在编译前定义为全局变量 (依次占用下标 0, 1, ...), 由宿主在运行前赋值
+    std::shared_ptr<const CompiledProgram> CompileProgram(const std::string& source, const RunOptions& options = RunOptions(),
+                                                          const std::vector<std::string>& globals = std::vector<std::string>());
+
+    // 进程级的编译缓存: 按源码哈希和编译选项 (包括内置函数表) 查找编译好的程序, 多个线程运行同一个脚本时只编译一次.
+    // 缓存的程序只读, 各线程的 VM 通过 AnchorSharedObjects 共享其中的常量和函数, 不复制常量池.
+    // 最多保留 capacity 个程序, 超出时淘汰最久没有用到的; 被淘汰的程序在正在运行它的 Isolate 结束后释放
+    class ProgramCache {
+    public:
+        static const size_t DefaultCapacity = 1024;
+
+        explicit ProgramCache(size_t capacity = DefaultCapacity) : capacity(capacity > 0 ? capacity : 1) {}
+
+        // 命中时直接返回, 否则编译后加入缓存; 编译在锁外进行, 不会阻塞其他脚本的查找
+        std::shared_ptr<const CompiledProgram> Get(const std::string& source, const RunOptions& options = RunOptions());
+
+        size_t Size();
+
+        void Clear();
+
+        // 修改容量 (至少为 1), 立即淘汰多出的程序
+        void SetCapacity(size_t capacity);
+
+        // 进程内共享的缓存, 容量为 DefaultCapacity, 宿主可以用 SetCapacity 调整
+        static ProgramCache& Shared();
+
+    private:
+        struct Entry {
+            size_t hash;
+            std::string source;
+            Backend backend;
+            int optimizeLevel;
+            std::shared_ptr<const BuiltinRegistry> builtins;
+            std::shared_ptr<const CompiledProgram> program;
+        };
+
+        // 命中时把程序移到最近使用的一端
+        std::shared_ptr<const CompiledProgram> find(size_t hash, const std::string& source, const RunOptions& options);
+
+        void evict();
+
+    private:
+        std::mutex mutex;
+        size_t capacity;
+        std::list<Entry> recent;    // 最近用到的在前
+        std::unordered_multimap<size_t, std::list<Entry>::iterator> programs;
+    };
+
+    // 隔离的执行实例: 每次运行使用自己的 VM, 栈和全局变量, 运行中创建的对象只属于这个实例.
+    // 与其他实例共享的只有只读的 CompiledProgram (包括它的内置函数表) 和进程级的运行时表 (true/false/null 等),
+    // 所以不同线程中的 Isolate 可以同时运行; 同一个 Isolate 同一时间只能在一个线程中使用
+    class Isolate {
+    public:
+        explicit Isolate(std::shared_ptr<const CompiledProgram> program) : program(program) {}
+
+        // 从头运行一次程序
+        void Run();
+
+    private:
+        std::shared_ptr<const CompiledProgram> program;
+    };
+} // namespace monkey
@@ -0,0 +1,122 @@
+#pragma once
+
+// libmonkey 的宿主 API: 把脚本编译一次, 之后由宿主反复赋值全局变量, 运行并读取结果,
+// 全程不经过文本输入输出. 用法:
+//
+//     auto program = monkey::CompileProgram("if (x > limit) { x } else { limit }", monkey::RunOptions(), {"x", "limit"});
+//     monkey::Evaluator eval(program);
+//     eval.SetGlobal("limit", monkey::MakeInteger(10));
+//     eval.SetGlobal("x", monkey::MakeInteger(42));
+//     int64_t value;
+//     monkey::AsInteger(eval.Run(), value);   // value == 42
+//
+// 宿主函数在编译前注册到 BuiltinRegistry, 脚本像调用内置函数一样调用它们, 实参直接从 VM 栈上读取:
+//
+//     std::shared_ptr<monkey::Object> clamp(monkey::ArgsView args) {
+//         int64_t x, lo, hi;
+//         if (!monkey::AsInteger(args[0], x) || !monkey::AsInteger(args[1], lo) || !monkey::AsInteger(args[2], hi)) {
+//             return std::make_shared<monkey::Error>("clamp: arguments must be INTEGER");
+//         }
+//         return monkey::MakeInteger(std::min(std::max(x, lo), hi));
+//     }
+//
+//     auto registry = std::make_shared<monkey::BuiltinRegistry>();
+//     registry->Register("clamp", clamp, 3, true);     // 名字, 函数, 参数个数, 无副作用
+//     monkey::RunOptions options;
+//     options.builtins = registry;
+//     auto program = monkey::CompileProgram("clamp(x, 0, 100)", options, {"x"});
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./isolate.h"
+#include "./object.h"
+#include "./vm.h"
+
+namespace monkey {
+    // 在一个常驻的 VM 上反复运行同一个编译好的程序 (只支持栈式后端).
+    // 全局变量在多次运行之间保留, 宿主没有设置的为 null; 同一个 Evaluator 同一时间只能在一个线程中使用
+    class Evaluator {
+    public:
+        explicit Evaluator(std::shared_ptr<const CompiledProgram> program);
+
+        // 按声明时的名字或下标 (CompiledProgram::GlobalIndex) 读写全局变量, 名字未声明时抛出 RunningError
+        void SetGlobal(const std::string& name, std::shared_ptr<Object> value);
+
+        void SetGlobal(int index, std::shared_ptr<Object> value);
+
+        std::shared_ptr<Object> GetGlobal(const std::string& name);
+
+        std::shared_ptr<Object> GetGlobal(int index);
+
+        // 从头运行一次程序, 返回主程序本次运行最后弹出栈的值: 通常是最后一个表达式语句的值,
+        // 顶层 let 弹出的是它定义的值; 什么都没有弹出时为 null
+        std::shared_ptr<Object> Run();
+
+    private:
+        int globalIndex(const std::string& name);
+
+    private:
+        std::shared_ptr<const CompiledProgram> program;
+        VM vm;
+    };
+
+    // 宿主值与 monkey 对象之间的转换
+    inline
+    std::shared_ptr<Object> MakeInteger(int64_t value) {
+        return std::make_shared<Integer>(value);
+    }
+
+    inline
+    std::shared_ptr<Object> MakeString(const std::string& value) {
+        return std::make_shared<Strin>(value);
+    }
+
+    inline
+    std::shared_ptr<Object> MakeBoolean(bool value) {
+        return value ? True : False;
+    }
+
+    inline
+    std::shared_ptr<Object> MakeNull() {
+        return null;
+    }
+
+    inline
+    std::shared_ptr<Object> MakeArray(std::vector<std::shared_ptr<Object>> elements) {
+        return std::make_shared<Array>(elements);
+    }
+
+    // 类型不符时返回 false, out 不变
+    inline
+    bool AsInteger(const std::shared_ptr<Object>& obj, int64_t& out) {
+        auto integer = dynamic_cast<Integer*>(obj.get());
+        if (integer == nullptr) {
+            return false;
+        }
+        out = integer->value;
+        return true;
+    }
+
+    inline
+    bool AsString(const std::shared_ptr<Object>& obj, std::string& out) {
+        auto str = dynamic_cast<Strin*>(obj.get());
+        if (str == nullptr) {
+            return false;
+        }
+        out = str->value;
+        return true;
+    }
+
+    inline
+    bool AsBoolean(const std::shared_ptr<Object>& obj, bool& out) {
+        auto boolean = dynamic_cast<Boolea*>(obj.get());
+        if (boolean == nullptr) {
+            return false;
+        }
+        out = boolean->value;
+        return true;
+    }
+} // namespace monkey
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "./builtins.h"
+
+// 原生扩展: 用 C++ 实现的函数编译成共享库, 运行时用 dlopen 加载, 追加到内置函数表中,
+// 脚本像调用 len 一样调用它们. 扩展用 extern "C" 导出注册入口:
+//
+//     extern "C" int monkey_native_init(monkey::BuiltinRegistry* registry, int abi) {
+//         if (abi != MONKEY_NATIVE_ABI) {
+//             return -1;
+//         }
+//         registry->Register("native_sum", nativeSum, 1, true);
+//         return 0;
+//     }
+//
+// 扩展直接使用解释器中的对象和 BuiltinRegistry, 宿主程序需要导出自己的符号 (-rdynamic, CMake 中的 ENABLE_EXPORTS)
+
+// 对象布局或 BuiltinRegistry 的接口不兼容时加一
+#define MONKEY_NATIVE_ABI 5
+
+namespace monkey {
+    // 扩展必须导出的注册入口, 返回 0 表示成功
+    using NativeInitFunction = int (*)(BuiltinRegistry* registry, int abi);
+
+    const char* const NativeInitSymbol = "monkey_native_init";
+
+    // 加载扩展并调用它的注册入口, 返回新增的函数个数; 失败时抛出 CompileError, registry 不变, 扩展被卸载.
+    // 已经编译的字节码可能引用扩展中的函数, 所以扩展加载后不再卸载
+    int LoadNativeExtension(BuiltinRegistry& registry, const std::string& path);
+} // namespace monkey
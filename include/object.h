@@ -8,6 +8,7 @@
 #include <functional>
 
 #include "./ast.h"
+#include "./stats.h"
 
 namespace monkey{
     /*** 定义对象系统 ***/
@@ -20,9 +21,45 @@ namespace monkey{
         virtual std::string type() = 0;
         virtual std::string inspect() = 0;
 
+        // 把 inspect() 的结果追加到 out, print 直接写进输出行而不构造临时字符串.
+        // 数组和 hash 的各层元素都追加到同一个 out 中, inspect() 也由它实现
+        virtual void inspectTo(std::string& out) {
+            out += inspect();
+        }
+
         virtual ~Object() = default;
     };
 
+    // 把十进制整数追加到 out, 不经过 std::to_string 的临时字符串. 每次除以 100 转换两位数字
+    inline void AppendInteger(std::string& out, int64_t value) {
+        static const char digitPairs[] =
+            "0001020304050607080910111213141516171819"
+            "2021222324252627282930313233343536373839"
+            "4041424344454647484950515253545556575859"
+            "6061626364656667686970717273747576777879"
+            "8081828384858687888990919293949596979899";
+        char buf[24];
+        char* end = buf + sizeof(buf);
+        char* p = end;
+        uint64_t n = value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+        while (n >= 100) {
+            auto i = (n % 100) * 2;
+            n /= 100;
+            *--p = digitPairs[i + 1];
+            *--p = digitPairs[i];
+        }
+        if (n >= 10) {
+            *--p = digitPairs[n * 2 + 1];
+            *--p = digitPairs[n * 2];
+        } else {
+            *--p = static_cast<char>('0' + n);
+        }
+        if (value < 0) {
+            *--p = '-';
+        }
+        out.append(p, end - p);
+    }
+
     // 可哈希对象
     class Hashable : public Object{
     public:
@@ -32,16 +69,22 @@ namespace monkey{
     // 整数对象
     class Integer : public Hashable{
     public:
-        int16_t value;
+        int64_t value;
 
-        Integer(int16_t value) : value(value){}
+        Integer(int64_t value) : value(value){ countAllocation(INTEGER_OBJ); }
 
         std::string type() override{
             return "INTEGER";
         }
 
         std::string inspect() override{
-            return std::to_string(value);
+            std::string out;
+            AppendInteger(out, value);
+            return out;
+        }
+
+        void inspectTo(std::string& out) override{
+            AppendInteger(out, value);
         }
 
         std::shared_ptr<HashKey> hashKey() override{
@@ -54,7 +97,7 @@ namespace monkey{
     public:
         bool value;
 
-        Boolea(bool value) : value(value){}
+        Boolea(bool value) : value(value){ countAllocation(BOOLEAN_OBJ); }
 
         std::string type() override{
             return "BOOLEAN";
@@ -64,6 +107,10 @@ namespace monkey{
             return value ? "true" : "false";
         }
 
+        void inspectTo(std::string& out) override{
+            out += value ? "true" : "false";
+        }
+
         std::shared_ptr<HashKey> hashKey() override{
             return std::make_shared<HashKey>(type(), value ? 1 : 0);
         }
@@ -74,7 +121,8 @@ namespace monkey{
     public:
         std::string value;
 
-        Strin(const std::string& value) : value(value){}
+        Strin(const std::string& value) : value(value){ countAllocation(STRING_OBJ); }
+        Strin(std::string&& value) : value(std::move(value)){ countAllocation(STRING_OBJ); }
 
         std::string type() override{
             return "STRING";
@@ -84,11 +132,14 @@ namespace monkey{
             return value;
         }
 
+        void inspectTo(std::string& out) override{
+            out += value;
+        }
+
         std::shared_ptr<HashKey> hashKey() override{
-            uint16_t hash = 0;
+            uint64_t hash = 5381;
             for (auto& c : value) {
-                hash = ((hash << 5) + hash) + c;
-                hash = hash & 0xFFFF;
+                hash = ((hash << 5) + hash) + static_cast<unsigned char>(c);
             }
             return std::make_shared<HashKey>(type(), hash);
         }
@@ -97,6 +148,8 @@ namespace monkey{
     // 空对象
     class Null : public Object{
     public:
+        Null(){ countAllocation(NULL_OBJ); }
+
         std::string type() override{
             return "NULL";
         }
@@ -104,6 +157,10 @@ namespace monkey{
         std::string inspect() override{
             return "null";
         }
+
+        void inspectTo(std::string& out) override{
+            out += "null";
+        }
     };
 
     // 返回值对象
@@ -111,7 +168,7 @@ namespace monkey{
     public:
         std::shared_ptr<Object> value;
 
-        ReturnValue(std::shared_ptr<Object> value) : value(value){}
+        ReturnValue(std::shared_ptr<Object> value) : value(value){ countAllocation(RETURN_VALUE_OBJ); }
 
         std::string type() override{
             return "RETURN_VALUE";
@@ -120,6 +177,10 @@ namespace monkey{
         std::string inspect() override{
             return value->inspect();
         }
+
+        void inspectTo(std::string& out) override{
+            value->inspectTo(out);
+        }
     };
 
     // 错误对象
@@ -127,7 +188,7 @@ namespace monkey{
     public:
         std::string message;
 
-        Error(const std::string& message) : message(message){}
+        Error(const std::string& message) : message(message){ countAllocation(ERROR_OBJ); }
 
         std::string type() override{
             return "ERROR";
@@ -136,6 +197,11 @@ namespace monkey{
         std::string inspect() override{
             return "ERROR: " + message;
         }
+
+        void inspectTo(std::string& out) override{
+            out += "ERROR: ";
+            out += message;
+        }
     };
 
     // 函数对象
@@ -145,7 +211,7 @@ namespace monkey{
         std::shared_ptr<BlockStatement> body;
         std::shared_ptr<Environment> env;
 
-        Function(std::vector<std::shared_ptr<Identifier>> parameters, std::shared_ptr<BlockStatement> body, std::shared_ptr<Environment> env) : parameters(parameters), body(body), env(env){}
+        Function(std::vector<std::shared_ptr<Identifier>> parameters, std::shared_ptr<BlockStatement> body, std::shared_ptr<Environment> env) : parameters(parameters), body(body), env(env){ countAllocation(FUNCTION_OBJ); }
 
         std::string type() override{
             return "FUNCTION";
@@ -171,11 +237,14 @@ namespace monkey{
         std::vector<uint8_t> instructions; // 指令集
         int numLocals; // 本地变量数
         int numParameters; // 参数数
+        int maxStackDepth = 0; // 操作数栈的最大深度, 由编译器静态计算, 调用时据此一次性检查栈空间
+        int numFree = 0; // 自由变量数
+        bool verified = false; // 已通过字节码校验, 见 VerifyBytecode
 
-        CompiledFunction(std::vector<uint8_t> instructions) : instructions(instructions), numLocals(0) {}
-        CompiledFunction(std::vector<uint8_t> instructions, int numLocals) : instructions(instructions), numLocals(numLocals) {}
+        CompiledFunction(std::vector<uint8_t> instructions) : instructions(instructions), numLocals(0) { countAllocation(COMPILED_FUNCTION_OBJ); }
+        CompiledFunction(std::vector<uint8_t> instructions, int numLocals) : instructions(instructions), numLocals(numLocals) { countAllocation(COMPILED_FUNCTION_OBJ); }
         CompiledFunction(std::vector<uint8_t> instructions, int numLocals, int numParameters) : 
-                        instructions(instructions), numLocals(numLocals), numParameters(numParameters) {}
+                        instructions(instructions), numLocals(numLocals), numParameters(numParameters) { countAllocation(COMPILED_FUNCTION_OBJ); }
 
         std::string type() override{
             return "COMPILED_FUNCTION";
@@ -186,13 +255,69 @@ namespace monkey{
         }
     }; 
 
+    class ArgsView;
+
+    // 正在执行内置函数的 VM, 内置函数通过它回调脚本中的函数
+    class Caller {
+    public:
+        virtual ~Caller() = default;
+
+        // 调用闭包或内置函数并返回结果. 闭包在当前 VM 上接着当前帧执行, 返回后帧数恢复原样
+        virtual std::shared_ptr<Object> Call(const std::shared_ptr<Object>& fn, ArgsView args) = 0;
+
+        // 供 pmap/preduce 在其他线程中回调: 与本 VM 共享常量, 内置函数和全局变量 (只读) 的新 VM.
+        // 只在本 VM 停在当前内置函数中时使用; 不支持时返回 nullptr
+        virtual std::unique_ptr<Caller> NewWorker() { return nullptr; }
+
+        // values 中的函数能否同时在多个线程中调用, 见 IsParallelSafe
+        virtual bool ParallelSafe(ArgsView values);
+    };
+
+    // 内置函数的实参: 直接指向 VM 栈 (或寄存器文件) 中连续的实参, 不复制, 只在调用期间有效
+    class ArgsView {
+    public:
+        ArgsView(const std::shared_ptr<Object>* data, size_t count, Caller* caller = nullptr) : data(data), count(count), from(caller) {}
+
+        size_t size() const { return count; }
+
+        bool empty() const { return count == 0; }
+
+        const std::shared_ptr<Object>& operator[](size_t i) const { return data[i]; }
+
+        const std::shared_ptr<Object>* begin() const { return data; }
+
+        const std::shared_ptr<Object>* end() const { return data + count; }
+
+        // 调用这个内置函数的 VM, 不在 VM 中调用时为 nullptr
+        Caller* caller() const { return from; }
+
+    private:
+        const std::shared_ptr<Object>* data;
+        size_t count;
+        Caller* from;
+    };
+
+    inline bool Caller::ParallelSafe(ArgsView values) { return false; }
+
     // 内置函数对象
     class Builtin : public Object{
     public:
-        using builtin_function = std::function<std::shared_ptr<Object>(std::vector<std::shared_ptr<Object>>)>;
+        using builtin_function = std::shared_ptr<Object> (*)(ArgsView args);
         builtin_function fn;
+        std::string name;   // 注册名, 用于统计调用次数
+        int arity;          // 参数个数, -1 表示不定, 由函数自己检查
+        bool pure;          // 没有副作用, 值不被使用时调用可以删除
+
+        Builtin(builtin_function fn, int arity = -1, bool pure = false) : fn(fn), arity(arity), pure(pure){ countAllocation(BUILTIN_OBJ); }
 
-        Builtin(builtin_function fn) : fn(fn){}
+        // 检查参数个数后调用; 与内置函数自己的检查一样, 个数不符时返回错误对象
+        std::shared_ptr<Object> call(ArgsView args) {
+            if (arity >= 0 && args.size() != static_cast<size_t>(arity)) {
+                return std::make_shared<Error>("wrong number of arguments in builtin function(" + name + "). got="
+                                               + std::to_string(args.size()) + ", want=" + std::to_string(arity));
+            }
+            return fn(args);
+        }
 
         std::string type() override{
             return "BUILTIN";
@@ -209,8 +334,8 @@ namespace monkey{
         std::shared_ptr<CompiledFunction> fn; // 函数
         std::vector<std::shared_ptr<Object>> free;  // 自由变量
 
-        Closure(std::shared_ptr<CompiledFunction> fn) : fn(fn){}
-        Closure(std::shared_ptr<CompiledFunction> fn, std::vector<std::shared_ptr<Object>> free) : fn(fn), free(free){}
+        Closure(std::shared_ptr<CompiledFunction> fn) : fn(fn){ countAllocation(CLOSURE_OBJ); }
+        Closure(std::shared_ptr<CompiledFunction> fn, std::vector<std::shared_ptr<Object>> free) : fn(fn), free(free){ countAllocation(CLOSURE_OBJ); }
 
         std::string type() override{
             return "CLOSURE";
@@ -222,27 +347,98 @@ namespace monkey{
     };
 
     // 数组对象
+    // 数组对象. 元素全是整数时紧凑存储为 int64_t (packed), 不再为每个元素单独分配 Integer;
+    // 通用代码用 size()/at() 访问元素, 只有 packed 为 false 时 elements 才保存元素
     class Array : public Object{
     public:
         std::vector<std::shared_ptr<Object>> elements;
+        std::vector<int64_t> ints;  // packed 时的元素
+        bool packed = false;
 
-        Array(std::vector<std::shared_ptr<Object>> elements) : elements(elements){}
+        Array(std::vector<std::shared_ptr<Object>> elements) : elements(std::move(elements)){
+            countAllocation(ARRAY_OBJ);
+            pack();
+        }
+        // 空数组不紧凑存储, 与 pack() 一致
+        Array(std::vector<int64_t> ints) : ints(std::move(ints)), packed(!this->ints.empty()){ countAllocation(ARRAY_OBJ); }
+
+        size_t size() const {
+            return packed ? ints.size() : elements.size();
+        }
+
+        // packed 时新建 Integer
+        std::shared_ptr<Object> at(size_t i) const {
+            return packed ? std::make_shared<Integer>(ints[i]) : elements[i];
+        }
+
+        // 所有元素的副本, packed 时逐个装箱
+        std::vector<std::shared_ptr<Object>> boxed() const {
+            if (!packed) {
+                return elements;
+            }
+            std::vector<std::shared_ptr<Object>> out;
+            out.reserve(ints.size());
+            for (auto value : ints) {
+                out.push_back(std::make_shared<Integer>(value));
+            }
+            return out;
+        }
 
         std::string type() override{
             return "ARRAY";
         }
 
         std::string inspect() override{
-            std::string out = "";
-            out += "[";
-            for (size_t i = 0; i < elements.size(); ++i) {
-                out += elements[i]->inspect();
-                if (i != elements.size() - 1) {
+            std::string out;
+            inspectTo(out);
+            return out;
+        }
+
+        void inspectTo(std::string& out) override{
+            out += '[';
+            for (size_t i = 0; i < size(); ++i) {
+                if (i != 0) {
                     out += ", ";
                 }
+                if (packed) {
+                    AppendInteger(out, ints[i]);
+                } else {
+                    elements[i]->inspectTo(out);
+                }
             }
-            out += "]";
-            return out;
+            out += ']';
+        }
+
+    private:
+        void pack() {
+            if (elements.empty()) {
+                return;
+            }
+            for (auto& e : elements) {
+                if (dynamic_cast<Integer*>(e.get()) == nullptr) {
+                    return;
+                }
+            }
+            ints.reserve(elements.size());
+            for (auto& e : elements) {
+                ints.push_back(static_cast<Integer*>(e.get())->value);
+            }
+            std::vector<std::shared_ptr<Object>>().swap(elements);
+            packed = true;
+        }
+    };
+
+    // 迭代器对象: 按需产生元素 (如 lines 返回的文件行), map/filter/reduce/each 可以直接遍历.
+    // 只能遍历一遍, 不能在多个线程中同时使用
+    class Iterator : public Object{
+    public:
+        Iterator(){ countAllocation(ITERATOR_OBJ); }
+
+        // 下一个元素, 没有时返回 nullptr
+        virtual std::shared_ptr<Object> next() = 0;
+
+        std::string type() override{
+            return "ITERATOR";
         }
     };
 
@@ -250,9 +446,9 @@ namespace monkey{
     class HashKey : public Object{
     public: 
         std::string objectType;
-        uint16_t value;
+        uint64_t value;
 
-        HashKey(std::string objectType, uint16_t value) : objectType(objectType), value(value){}
+        HashKey(std::string objectType, uint64_t value) : objectType(objectType), value(value){ countAllocation(HASH_KEY_OBJ); }
 
         bool operator<(const HashKey& other) const {
             if (objectType == other.objectType) {
@@ -279,14 +475,22 @@ namespace monkey{
         std::shared_ptr<Object> key;
         std::shared_ptr<Object> value;
 
-        HashPair(std::shared_ptr<Object> key, std::shared_ptr<Object> value) : key(key), value(value){}
+        HashPair(std::shared_ptr<Object> key, std::shared_ptr<Object> value) : key(key), value(value){ countAllocation(HASH_PAIR_OBJ); }
 
         std::string type() override{
             return "HASH_PAIR";
         }
 
         std::string inspect() override{
-            return key->inspect() + " : " + value->inspect();
+            std::string out;
+            inspectTo(out);
+            return out;
+        }
+
+        void inspectTo(std::string& out) override{
+            key->inspectTo(out);
+            out += " : ";
+            value->inspectTo(out);
         }
     };
 
@@ -297,6 +501,7 @@ namespace monkey{
         std::map<HashKey, std::shared_ptr<HashPair>> pairs_for_use;
 
         HashTable(std::map<std::shared_ptr<HashKey>, std::shared_ptr<HashPair>> pairs) : pairs(pairs) {
+            countAllocation(HASH_TABLE_OBJ);
             for (auto& pair : pairs) {
                 pairs_for_use[*pair.first] = pair.second;
             }
@@ -324,18 +529,22 @@ namespace monkey{
         }
 
         std::string inspect() override{
-            std::string out = "";
-            out += "{";
-            int i = 0;
+            std::string out;
+            inspectTo(out);
+            return out;
+        }
+
+        void inspectTo(std::string& out) override{
+            out += '{';
+            bool first = true;
             for (auto& pair : pairs) {
-                out += pair.second->inspect();
-                if (i != pairs.size() - 1) {
+                if (!first) {
                     out += ", ";
                 }
-                ++i;
+                first = false;
+                pair.second->inspectTo(out);
             }
-            out += "}";
-            return out;
+            out += '}';
         }
     };
 
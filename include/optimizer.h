@@ -0,0 +1,26 @@
+#pragma once
+
+#include "./ast.h"
+#include "./code.h"
+#include "./compiler.h"
+
+namespace monkey {
+    // 优化级别: ./monkey run -O0 | -O1 | -O2
+    const int OptimizeNone = 0;         // 不优化
+    const int OptimizePeephole = 1;     // 窥孔优化
+    const int OptimizeDeadCode = 2;     // 窥孔优化 + 删除不可达指令和 AST 中的死代码 (默认)
+    const int DefaultOptimizeLevel = OptimizeDeadCode;
+
+    // 优化一段栈式字节码, 返回重新编码并重定位跳转后的指令
+    // isMain 为 true 时保留结尾的 OpPop, REPL 依赖它回显最后一个表达式的值
+    Instructions OptimizeInstructions(Instructions& ins, int level, bool isMain);
+
+    // 优化主程序以及常量池中下标 >= firstConstant 的函数 (包括预先构造的闭包中的函数)
+    void OptimizeBytecode(std::shared_ptr<ByteCode> bytecode, int level, size_t firstConstant = 0);
+
+    // 在编译前删除 AST 中的死代码: return 之后的语句, 条件为字面量的 if 中不会执行的分支,
+    // 值未被使用的纯表达式语句, 以及函数中从未被引用的纯值 let 绑定.
+    // 给出 builtins 时, 对其中标记为 pure 的函数的调用也当作纯表达式; 程序必须是完整的 (REPL 的单行输入
+    // 可能调用之前几行中遮蔽了内置函数的绑定, 不能给出)
+    void EliminateDeadCode(std::shared_ptr<Program> program, const BuiltinRegistry* builtins = nullptr);
+} // namespace monkey
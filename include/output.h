@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+namespace monkey {
+    // print 写入的输出缓冲. 内容先攒在内存中, 满了, 显式 Flush (脚本中的 flush()) 或进程退出时才写到文件,
+    // 不再每行刷新一次. 一次 Write 的内容整块写入, 多个线程 (isolate) 同时 print 时行不会交错
+    class OutputSink {
+    public:
+        enum Mode {
+            Buffered,       // 缓冲满时写出
+            LineBuffered,   // 每次 Write 的内容含换行时写出, 用于交互模式
+            Unbuffered,     // 每次 Write 都写出
+        };
+
+        static const size_t DefaultCapacity = 64 * 1024;
+
+        explicit OutputSink(FILE* file, size_t capacity = DefaultCapacity, Mode mode = Buffered);
+
+        ~OutputSink();
+
+        void Write(const char* data, size_t size);
+
+        void Write(const std::string& s) { Write(s.data(), s.size()); }
+
+        // 写出缓冲的内容并刷新文件
+        void Flush();
+
+        // 改变模式或容量前先写出已缓冲的内容. capacity 为 0 时等同于 Unbuffered
+        void Configure(size_t capacity, Mode mode);
+
+    private:
+        void flushLocked();
+
+        std::mutex mutex;
+        FILE* file;
+        std::string buffer;
+        size_t capacity;
+        Mode mode;
+    };
+
+    // 标准输出的缓冲, 进程正常退出时写出剩余内容. 默认 Buffered, 标准输出是终端时为 LineBuffered.
+    // 其他代码直接写 std::cout 之前要先 Flush, 否则顺序会乱
+    OutputSink& StandardOutput();
+} // namespace monkey
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "./define.h"
+#include "./object.h"
+
+namespace monkey {
+    // pmap/preduce 使用的线程数 (包括调用它们的线程). 默认为 CPU 核数, n <= 0 时恢复默认
+    void SetParallelWorkers(int n);
+
+    int ParallelWorkers();
+
+    // 一个函数体的字节码中与并行执行有关的部分, 由各 VM 按自己的指令格式解码
+    struct FunctionEffects {
+        bool setsGlobal = false;        // 写全局变量
+        std::vector<int> globals;       // 读到的全局变量
+        std::vector<int> builtins;      // 取到的内置函数
+        std::vector<int> functions;     // 创建闭包用到的常量 (CompiledFunction)
+    };
+
+    using EffectsDecoder = std::function<void(CompiledFunction& fn, FunctionEffects& effects)>;
+
+    // values 中的闭包 (以及它们的自由变量, 能读到的全局变量和其中创建的闭包) 能否在多个线程中同时调用:
+    // 不写全局变量, 只调用纯内置函数或只通过回调产生副作用的 map/filter/reduce/each/pmap/preduce/sort, 也碰不到迭代器
+    bool IsParallelSafe(ArgsView values, const EffectsDecoder& decode, const Constants& constants,
+                        const Globals& globals, const std::vector<std::shared_ptr<Object>>& builtins);
+
+    // 把 0 ~ count-1 号任务分给 ParallelWorkers() 个线程执行, 全部完成后返回.
+    // 当前线程用 self 执行, 其余线程各用一个 self.NewWorker(); 每个线程先做连续的一段任务, 做完后从其他线程的队列尾部窃取.
+    // 任务抛出的第一个异常在当前线程重新抛出. 在任务中再次调用 (嵌套的 pmap) 时在当前线程顺序执行
+    void ParallelFor(Caller& self, size_t count, const std::function<void(Caller& caller, size_t index)>& task);
+} // namespace monkey
@@ -21,18 +21,7 @@ namespace monkey{
         INDEX           // array[index]
     };
 
-    static std::map<TokenType, prec> precedences = {
-        {TokenType::EQ, prec::EQUALS},
-        {TokenType::NOT_EQ, prec::EQUALS},
-        {TokenType::LT, prec::LESSGREATER},
-        {TokenType::GT, prec::LESSGREATER},
-        {TokenType::PLUS, prec::SUM},
-        {TokenType::MINUS, prec::SUM},
-        {TokenType::SLASH, prec::PRODUCT},
-        {TokenType::ASTERISK, prec::PRODUCT},
-        {TokenType::LPAREN, prec::CALL},
-        {TokenType::LBRACKET, prec::INDEX}
-    };
+    extern const std::map<TokenType, prec> precedences;
 
     class Parser{
     public:
@@ -58,6 +47,8 @@ namespace monkey{
             registerPrefix(TokenType::IF, &Parser::parseIfExpression);
             registerPrefix(TokenType::FUNCTION, &Parser::parseFunctionLiteral);
             registerPrefix(TokenType::LBRACE, &Parser::parseHashLiteral);
+            registerPrefix(TokenType::WHILE, &Parser::parseWhileExpression);
+            registerPrefix(TokenType::FOR, &Parser::parseForExpression);
 
             // 注册中缀解析函数
             registerInfix(TokenType::PLUS, &Parser::parseInfixExpression);
@@ -120,6 +111,9 @@ namespace monkey{
         // 解析 return 语句
         std::shared_ptr<ReturnStatement> parseReturnStatement();
 
+        // 解析赋值语句
+        std::shared_ptr<AssignStatement> parseAssignStatement();
+
         // 解析表达式语句
         std::shared_ptr<ExpressionStatement> parseExpressionStatement();
 
@@ -162,6 +156,12 @@ namespace monkey{
         // 解析 if 表达式
         std::shared_ptr<Expression> parseIfExpression();
 
+        // 解析 while 循环
+        std::shared_ptr<Expression> parseWhileExpression();
+
+        // 解析 for 循环
+        std::shared_ptr<Expression> parseForExpression();
+
         // 解析块语句
         std::shared_ptr<BlockStatement> parseBlockStatement();
 
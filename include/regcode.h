@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "./define.h"
+#include "./errors.h"
+
+namespace monkey {
+    // 寄存器字节码: 每条指令定长 8 字节, 三地址 (a, b, c) 操作当前帧的寄存器
+    // 算术/比较指令的 b, c 可以直接引用常量 (RK 编码, 见 RegConstantBit)
+    const Opcode ROpMove = 0;          // R[a] = R[b]
+    const Opcode ROpLoadConstant = 1;  // R[a] = K[b]
+    const Opcode ROpLoadTrue = 2;      // R[a] = true
+    const Opcode ROpLoadFalse = 3;     // R[a] = false
+    const Opcode ROpLoadNull = 4;      // R[a] = null
+    const Opcode ROpGetGlobal = 5;     // R[a] = G[b]
+    const Opcode ROpSetGlobal = 6;     // G[b] = R[a]
+    const Opcode ROpGetBuiltin = 7;    // R[a] = builtins[b]
+    const Opcode ROpGetFree = 8;       // R[a] = closure.free[b]
+    const Opcode ROpCurrentClosure = 9; // R[a] = 当前闭包
+    const Opcode ROpAdd = 10;          // R[a] = RK[b] + RK[c]
+    const Opcode ROpSub = 11;
+    const Opcode ROpMul = 12;
+    const Opcode ROpDiv = 13;
+    const Opcode ROpEqual = 14;
+    const Opcode ROpNotEqual = 15;
+    const Opcode ROpGreaterThan = 16;
+    const Opcode ROpMinus = 17;        // R[a] = -R[b]
+    const Opcode ROpBang = 18;         // R[a] = !R[b]
+    const Opcode ROpJump = 19;         // pc = a
+    const Opcode ROpJumpNotTruthy = 20; // if !R[a] then pc = b
+    const Opcode ROpArray = 21;        // R[a] = [R[b], ..., R[b+c-1]]
+    const Opcode ROpHash = 22;         // R[a] = {R[b]: R[b+1], ...} 共 c 对
+    const Opcode ROpIndex = 23;        // R[a] = R[b][R[c]]
+    const Opcode ROpCall = 24;         // R[a] = R[b](R[b+1], ..., R[b+c])
+    const Opcode ROpTailCall = 25;     // return R[b](R[b+1], ..., R[b+c]), 复用当前帧
+    const Opcode ROpReturn = 26;       // return R[a]
+    const Opcode ROpReturnNull = 27;   // return null
+    const Opcode ROpClosure = 28;      // R[a] = closure(K[b], free = R[a], ..., R[a+c-1])
+
+    // RK 编码: 置位时低 15 位是常量下标, 否则是寄存器
+    const uint16_t RegConstantBit = 0x8000;
+    const int MaxRegisters = RegConstantBit;
+
+    struct RegInstruction {
+        Opcode op;
+        uint16_t a;
+        uint16_t b;
+        uint16_t c;
+    };
+
+    const size_t RegInstructionSize = sizeof(RegInstruction);
+
+    struct RegDefination {
+        std::string Name;
+        int NumOperands;
+    };
+
+    extern const std::map<Opcode, RegDefination> regDefinations;
+
+    inline
+    void PutRegInstruction(Instructions &ins, RegInstruction instruction) {
+        auto pos = ins.size();
+        ins.resize(pos + RegInstructionSize);
+        std::memcpy(&ins[pos], &instruction, RegInstructionSize);
+    }
+
+    inline
+    RegInstruction ReadRegInstruction(const byte* code, int pc) {
+        RegInstruction instruction;
+        std::memcpy(&instruction, code + pc * RegInstructionSize, RegInstructionSize);
+        return instruction;
+    }
+
+    std::string RegInstructionsToString(Instructions &ins);
+} // namespace monkey
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "./ast.h"
+#include "./regcode.h"
+#include "./compiler.h"
+#include "./symbol.h"
+
+namespace monkey {
+    struct RegisterScope {
+        Instructions instructions;
+        int nextRegister = 0;   // 下一个空闲的临时寄存器
+        int maxRegisters = 0;   // 该函数需要的寄存器数
+    };
+
+    // 寄存器后端: 从与 Compiler 相同的 AST 生成三地址寄存器字节码
+    // 函数的参数和局部变量占据寄存器 0..numLocals-1 (与 SymbolTable 的下标一致), 其上为临时寄存器
+    class RegisterCompiler {
+    public:
+        RegisterCompiler(std::shared_ptr<SymbolTable> symTable) {
+            scopes.emplace_back(RegisterScope());
+            constants = std::make_shared<Constants>();
+            symbolTable = symTable;
+        }
+
+        ~RegisterCompiler() = default;
+
+        void Compile(std::shared_ptr<Program> program);
+
+        std::shared_ptr<ByteCode> Bytecode() {
+            auto byte_code = std::make_shared<ByteCode>(scopes.back().instructions, constants);
+            byte_code->numRegisters = scopes.back().maxRegisters;
+            byte_code->numGlobals = symbolTable->GetNumDefinitions();
+            return byte_code;
+        }
+
+    private:
+        void compileStatement(std::shared_ptr<Statement> stmt);
+
+        // 编译表达式, 返回结果所在的寄存器; dest >= 0 时结果必须写入 dest
+        int compileExpression(std::shared_ptr<Expression> expr, int dest);
+
+        // 编译二元运算的操作数, 整数和字符串字面量直接编码为 RK 常量
+        int compileOperand(std::shared_ptr<Expression> expr);
+
+        // 编译函数返回值所在位置的表达式/语句块, 调用编译为尾调用
+        void compileReturnValue(std::shared_ptr<Expression> expr);
+
+        void compileReturnBlock(std::shared_ptr<BlockStatement> block);
+
+        // 编译 if 分支, 分支的值写入 dest
+        void compileBlockValue(std::shared_ptr<BlockStatement> block, int dest);
+
+        void compileFunction(std::shared_ptr<FunctionLiteral> func, int dest);
+
+        void compileCall(std::shared_ptr<CallExpression> call, int dest, bool tail);
+
+        // 将符号的值加载到寄存器 dest
+        void loadSymbol(const Symbol& symbol, int dest);
+
+        void storeSymbol(const Symbol& symbol, int source);
+
+        int target(int dest) {
+            return dest >= 0 ? dest : allocRegister();
+        }
+
+        int allocRegister() {
+            auto& scope = scopes.back();
+            if (scope.nextRegister >= MaxRegisters) {
+                throw CompileError{"too many registers in function"};
+            }
+            auto reg = scope.nextRegister++;
+            if (scope.nextRegister > scope.maxRegisters) {
+                scope.maxRegisters = scope.nextRegister;
+            }
+            return reg;
+        }
+
+        int registerMark() {
+            return scopes.back().nextRegister;
+        }
+
+        void freeRegisters(int mark) {
+            scopes.back().nextRegister = mark;
+        }
+
+        int emit(Opcode op, int a = 0, int b = 0, int c = 0) {
+            auto& ins = scopes.back().instructions;
+            auto pc = static_cast<int>(ins.size() / RegInstructionSize);
+            PutRegInstruction(ins, RegInstruction{op, static_cast<uint16_t>(a), static_cast<uint16_t>(b), static_cast<uint16_t>(c)});
+            return pc;
+        }
+
+        int currentPc() {
+            return static_cast<int>(scopes.back().instructions.size() / RegInstructionSize);
+        }
+
+        // 回填跳转目标
+        void patchJump(int pc, int targetPc);
+
+        int addConstant(std::shared_ptr<Object> obj) {
+            constants->emplace_back(obj);
+            return constants->size() - 1;
+        }
+
+        void enterScope(int numLocals) {
+            RegisterScope scope;
+            scope.nextRegister = numLocals;
+            scope.maxRegisters = numLocals;
+            scopes.emplace_back(scope);
+            symbolTable = NewEnclosedSymbolTable(symbolTable);
+        }
+
+        RegisterScope leaveScope() {
+            auto scope = scopes.back();
+            scopes.pop_back();
+            symbolTable = symbolTable->GetOuter();
+            return scope;
+        }
+
+    private:
+        std::vector<RegisterScope> scopes;
+        std::shared_ptr<Constants> constants;
+        std::shared_ptr<SymbolTable> symbolTable;
+    }; // class RegisterCompiler
+
+    // 统计函数体中 let 定义的局部变量数 (不进入嵌套函数)
+    int CountLocalDefinitions(std::shared_ptr<Node> node);
+} // namespace monkey
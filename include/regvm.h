@@ -0,0 +1,99 @@
+#pragma once
+
+#include "./regcode.h"
+#include "./vm.h"
+
+namespace monkey {
+    struct RegFrame {
+        std::shared_ptr<Closure> cl;
+        int pc;         // 下一条要执行的指令
+        int base;       // 该帧寄存器 0 在寄存器文件中的位置
+        int retReg;     // 返回值写入的寄存器 (寄存器文件中的绝对位置)
+
+        RegFrame(std::shared_ptr<Closure> cl, int base, int retReg) : cl(cl), pc(0), base(base), retReg(retReg) {}
+    };
+
+    // 执行 RegisterCompiler 生成的寄存器字节码
+    // 所有帧共享一个按需增长的寄存器文件, 被调函数的寄存器窗口紧接在调用者的实参之后
+    class RegisterVM : public Caller {
+    public:
+        RegisterVM(std::shared_ptr<ByteCode> bc) {
+            useAnchoredObjects(AnchorSharedObjects(bc->constants, bc->builtins));
+            auto mainFn = std::make_shared<CompiledFunction>(bc->instructions, bc->numRegisters, 0);
+            auto mainClosure = std::make_shared<Closure>(mainFn);
+            frames.emplace_back(mainClosure, 0, 0);
+            frames.reserve(MaxFrames);
+            registers.resize(std::max(bc->numRegisters, 1));
+            globals = std::make_shared<Globals>(bc->numGlobals);
+        }
+        // 工作线程中的 VM (见 NewWorker): 只有一个空的主帧, 共享 globals
+        RegisterVM(const AnchoredObjects& objects, std::shared_ptr<Globals> sharedGlobals) {
+            useAnchoredObjects(objects);
+            auto mainClosure = std::make_shared<Closure>(std::make_shared<CompiledFunction>(Instructions(), 1, 0));
+            frames.emplace_back(mainClosure, 0, 0);
+            frames.reserve(MaxFrames);
+            registers.resize(1);
+            globals = sharedGlobals;
+        }
+        ~RegisterVM() override = default;
+
+        void Run();
+
+        // 供内置函数回调: 闭包在新的帧和单独的寄存器文件中执行到返回为止
+        std::shared_ptr<Object> Call(const std::shared_ptr<Object>& fn, ArgsView args) override;
+
+        std::unique_ptr<Caller> NewWorker() override;
+
+        bool ParallelSafe(ArgsView values) override;
+
+        // 主程序 return 的值, 没有 return 时为 null
+        std::shared_ptr<Object> Result() { return result; }
+
+        std::shared_ptr<Object> GetGlobal(int index) { return (*globals)[index]; }
+
+    private:
+        // 执行指令, 直到第 exitDepth 个帧返回, 返回它的返回值
+        std::shared_ptr<Object> execute(size_t exitDepth);
+
+        std::shared_ptr<Object> executeBinaryOperation(Opcode op, const std::shared_ptr<Object>& left, const std::shared_ptr<Object>& right);
+
+        std::shared_ptr<Object> executeComparison(Opcode op, const std::shared_ptr<Object>& left, const std::shared_ptr<Object>& right);
+
+        std::shared_ptr<Object> executeIndexExpression(const std::shared_ptr<Object>& left, const std::shared_ptr<Object>& index);
+
+        std::shared_ptr<Object> callBuiltin(Builtin* fn, int first, int numArgs);
+
+        std::shared_ptr<Array> buildArray(int first, int count);
+
+        std::shared_ptr<HashTable> buildHash(int first, int count);
+
+        // 保证寄存器文件至少有 size 个寄存器
+        void ensureRegisters(int size);
+
+        bool isTruthy(const std::shared_ptr<Object>& obj);
+
+        void useAnchoredObjects(const AnchoredObjects& objects) {
+            constants = objects.constants;
+            True = objects.True;
+            False = objects.False;
+            null = objects.null;
+            builtinFns = objects.builtins;
+            registry = objects.registry;
+            result = null;
+        }
+
+    private:
+        std::shared_ptr<Constants> constants;
+        // 见 AnchorSharedObjects, 与全局的 True/False/null 同名
+        std::shared_ptr<Boolea> True;
+        std::shared_ptr<Boolea> False;
+        std::shared_ptr<Null> null;
+        std::vector<std::shared_ptr<Object>> builtinFns;
+        std::shared_ptr<const BuiltinRegistry> registry;
+        std::shared_ptr<Globals> globals;
+        std::vector<std::shared_ptr<Object>> registers;
+        std::vector<RegFrame> frames;
+        std::vector<std::vector<std::shared_ptr<Object>>> spareRegisters;   // Call 用过的寄存器文件, 留作下次回调
+        std::shared_ptr<Object> result;
+    }; // class RegisterVM
+} // namespace monkey
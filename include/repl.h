@@ -6,6 +6,7 @@
 #include <memory>
 
 #include "./include.h"
+#include "../utils/timer.h"
 
 namespace monkey{
     static const std::string PROMPT = "\033[32m>> \033[0m";
@@ -36,11 +37,17 @@ namespace monkey{
     void printParserErrors(std::ofstream& output, std::string errors);
 
     // repl
-    bool start_run(std::ifstream& input, std::ostream& output);
+    bool start_run(std::ifstream& input, std::ostream& output, const RunOptions& options = RunOptions());
 
     void start_cmd(std::istream& in, std::ostream& out);
 
-    void registeBuiltinFunctions(std::shared_ptr<SymbolTable> symbolTablePtr);
+    void registeBuiltinFunctions(std::shared_ptr<SymbolTable> symbolTablePtr, const BuiltinRegistry& registry = *BuiltinRegistry::Default());
+
+    // --stats: 单独计时一次词法分析并统计 token 数
+    void recordLexStats(const std::string& program);
+
+    // --stats: 统计字节码大小和常量池大小
+    void recordBytecodeStats(std::shared_ptr<ByteCode> bytecode);
 
     void doPreAction(std::shared_ptr<SymbolTable> symbolTablePtr, 
                     std::shared_ptr<Constants> constantsPtr, 
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include <string>
+#include <ostream>
+
+namespace monkey {
+    // 对象类型, 用于按类型统计分配次数
+    enum ObjectKind {
+        INTEGER_OBJ = 0,
+        BOOLEAN_OBJ,
+        STRING_OBJ,
+        NULL_OBJ,
+        RETURN_VALUE_OBJ,
+        ERROR_OBJ,
+        FUNCTION_OBJ,
+        COMPILED_FUNCTION_OBJ,
+        BUILTIN_OBJ,
+        CLOSURE_OBJ,
+        ARRAY_OBJ,
+        HASH_KEY_OBJ,
+        HASH_PAIR_OBJ,
+        HASH_TABLE_OBJ,
+        ITERATOR_OBJ,
+        OBJECT_KIND_COUNT
+    };
+
+    extern const char* ObjectKindNames[OBJECT_KIND_COUNT];
+
+    // 运行时统计, 仅在 enabled 时收集 (./monkey run --stats)
+    struct RuntimeStats {
+        bool enabled = false;
+
+        // 各阶段耗时(秒)
+        double lexTime = 0;
+        double parseTime = 0;
+        double compileTime = 0;
+        double executeTime = 0;
+        bool executing = false;
+        std::chrono::high_resolution_clock::time_point executeStart;
+
+        size_t tokens = 0;
+        size_t bytecodeSize = 0;    // 主程序与所有函数的指令字节数
+        size_t constantsSize = 0;
+
+        uint64_t allocations[OBJECT_KIND_COUNT] = {};
+        int peakStackDepth = 0;     // VM::sp 的峰值
+        int peakFrameDepth = 0;     // VM::framesIndex 的峰值
+        uint64_t instructionsExecuted = 0;
+        std::map<std::string, uint64_t> builtinCalls;
+
+        void reset();
+
+        void beginExecute();
+
+        void endExecute();
+
+        // 执行阶段耗时, 执行中调用时返回已经过的时间
+        double currentExecuteTime() const;
+    };
+
+    // 每个线程各自统计, 并发运行的 VM 互不干扰
+    extern thread_local RuntimeStats runtimeStats;
+
+    inline
+    void countAllocation(ObjectKind kind) {
+        if (runtimeStats.enabled) {
+            ++runtimeStats.allocations[kind];
+        }
+    }
+
+    void printStats(std::ostream& output);
+} // namespace monkey
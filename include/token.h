@@ -50,42 +50,13 @@ namespace monkey {
         IF,     // keyword if
         ELSE,   // keyword else
         RETURN, // keyword return
-        MACRO // keyword macro
+        MACRO, // keyword macro
+        WHILE,  // keyword while
+        FOR     // keyword for
     };
 
-    static std::vector<std::string> TokenTypeString = {
-        "ILLEGAL",
-        "EOF",
-        "IDENT",
-        "INT",
-        "STRING",
-        "ASSIGN",
-        "PLUS",
-        "MINUS",
-        "BANG",
-        "ASTERISK",
-        "SLASH",
-        "LT",
-        "GT",
-        "EQ",
-        "NOT_EQ",
-        "COMMA",
-        "SEMICOLON",
-        "COLON",
-        "LPAREN",
-        "RPAREN",
-        "LBRACKET",
-        "RBRACKET",
-        "LBRACE",
-        "RBRACE",
-        "FUNCTION",
-        "LET",
-        "TRUE",
-        "FALSE",
-        "IF",
-        "ELSE",
-        "RETURN"
-    };
+    // TokenType -> 名字, 定义在 token.cpp
+    extern const std::vector<std::string> TokenTypeString;
 
     class Token {
     public:
@@ -101,25 +72,10 @@ namespace monkey {
         std::string literal;
     };
 
-        // keywords maps: keywords -> TokenType
-    static std::map<std::string, TokenType> keywords = {
-        {"fn", TokenType::FUNCTION},
-        {"let", TokenType::LET},
-        {"true", TokenType::TRUE},
-        {"false", TokenType::FALSE},
-        {"if", TokenType::IF},
-        {"else", TokenType::ELSE},
-        {"return", TokenType::RETURN}
-    };
+    // keywords maps: keywords -> TokenType
+    extern const std::map<std::string, TokenType> keywords;
     
     // lookupIdent checks the keywords table to see whether the given
-    inline TokenType lookupIdent(std::string ident) {
-        auto it = keywords.find(ident);
-        if (it != keywords.end()) {
-            return it->second;
-        }
-        return TokenType::IDENT;
-    }
-    // TokenType lookupIdent(std::string ident);
+    TokenType lookupIdent(const std::string& ident);
     
 }; // namespace monkey
\ No newline at end of file
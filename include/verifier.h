@@ -0,0 +1,11 @@
+#pragma once
+
+#include "./code.h"
+#include "./compiler.h"
+
+namespace monkey {
+    // 校验栈式字节码 (主程序和常量池中尚未校验的函数): 操作码和操作数宽度, 跳转目标落在指令边界上,
+    // 常量/全局/局部/自由变量/内置函数下标, 以及每个汇合点的栈深度一致且不超过声明的 maxStackDepth.
+    // 通过校验后 VM 按快速路径执行, 不再逐条检查; 不合法时抛出 VerifyError
+    void VerifyBytecode(std::shared_ptr<ByteCode> bytecode);
+} // namespace monkey
@@ -3,14 +3,30 @@
 #include "./code.h"
 #include "./compiler.h"
 #include "./object.h"
+#include "./verifier.h"
 
 namespace monkey {
     const int StackSize = 2048;
     const int GlobalsSize = 65536;
     const int MaxFrames = 1024;
-    static std::shared_ptr<Boolea> True = std::make_shared<Boolea>(true);
-    static std::shared_ptr<Boolea> False = std::make_shared<Boolea>(false);
-    static std::shared_ptr<Null> null = std::make_shared<Null>();
+    // 全局唯一的 true/false/null 对象, 定义在 vm.cpp, 可以按指针比较
+    extern const std::shared_ptr<Boolea> True;
+    extern const std::shared_ptr<Boolea> False;
+    extern const std::shared_ptr<Null> null;
+
+    // 只读共享对象 (常量池, true/false/null, 内置函数) 在每个 VM 中的别名句柄.
+    // 句柄都与同一个 VM 私有的锚点共用引用计数, 多个线程中的 VM 复制这些对象时
+    // 只修改各自锚点的计数, 不会争用共享对象自己的引用计数; 锚点持有常量池和内置函数表, 保证句柄有效
+    struct AnchoredObjects {
+        std::shared_ptr<Constants> constants;
+        std::shared_ptr<Boolea> True;
+        std::shared_ptr<Boolea> False;
+        std::shared_ptr<Null> null;
+        std::vector<std::shared_ptr<Object>> builtins;
+        std::shared_ptr<const BuiltinRegistry> registry;    // builtins 所在的表, 用于给工作线程的 VM 重新建立锚点
+    };
+
+    AnchoredObjects AnchorSharedObjects(std::shared_ptr<Constants> shared, std::shared_ptr<const BuiltinRegistry> builtins);
 
     struct Frame {
         int ip;
@@ -21,12 +37,12 @@ namespace monkey {
         Frame(std::shared_ptr<Closure> cl) : ip(-1), basePointer(-1), cl(cl) {}
         Frame(std::shared_ptr<Closure> cl, uint16_t basePointer) : ip(-1), basePointer(basePointer), cl(cl) {}
 
-        Instructions getInstructions() {
+        Instructions& getInstructions() {
             return cl->fn->instructions;
         }
     };
 
-    class VM {
+    class VM : public Caller {
     public:
         VM() {
             sp = 0;
@@ -36,22 +52,52 @@ namespace monkey {
             auto mainFrame = std::make_shared<Frame>(mainClosure, 0);
             frames.push_back(mainFrame);
             frames.resize(MaxFrames);
-            constants = std::make_shared<Constants>();
+            useAnchoredObjects(AnchorSharedObjects(std::make_shared<Constants>(), BuiltinRegistry::Default()));
             globals = std::make_shared<Globals>(GlobalsSize);
             stack.resize(StackSize);
         }
-        VM(std::shared_ptr<ByteCode> bc) : constants(bc->constants) {
+        // 字节码可能来自缓存等不可信来源, 执行前先校验, Run 中不再逐条检查
+        VM(std::shared_ptr<ByteCode> bc) {
+            VerifyBytecode(bc);
+            useAnchoredObjects(AnchorSharedObjects(bc->constants, bc->builtins));
             sp = 0;
             framesIndex = 1;
             auto mainFn = std::make_shared<CompiledFunction>(bc->instructions);
+            mainFn->maxStackDepth = bc->maxStackDepth;
             auto mainClosure = std::make_shared<Closure>(mainFn);
             auto mainFrame = std::make_shared<Frame>(mainClosure, 0);
             frames.push_back(mainFrame);
             frames.resize(MaxFrames);
-            globals = std::make_shared<Globals>(GlobalsSize);
+            globals = std::make_shared<Globals>(bc->numGlobals);
+            stack.resize(StackSize);
+        }
+        // 工作线程中的 VM (见 NewWorker): 只有一个空的主帧, 共享 globals
+        VM(const AnchoredObjects& objects, std::shared_ptr<Globals> sharedGlobals) {
+            useAnchoredObjects(objects);
+            globals = sharedGlobals;
+            sp = 0;
+            framesIndex = 1;
+            auto mainClosure = std::make_shared<Closure>(std::make_shared<CompiledFunction>(Instructions()));
+            frames.push_back(std::make_shared<Frame>(mainClosure, 0));
+            frames.resize(MaxFrames);
             stack.resize(StackSize);
         }
-        ~VM() = default;
+        ~VM() override = default;
+
+        // 回到主程序开头, 保留全局变量, 以便同一个 VM 反复运行同一段程序
+        void Reset() {
+            sp = 0;
+            framesIndex = 1;
+            frames[0]->ip = -1;
+            // 本次运行没有弹出任何值时, LastPoppedStackElem() 不能返回上次运行留下的值
+            stack[0] = nullptr;
+        }
+
+        int NumGlobals() { return globals->size(); }
+
+        void SetGlobal(int index, std::shared_ptr<Object> value) { (*globals)[index] = value; }
+
+        std::shared_ptr<Object> GetGlobal(int index) { return (*globals)[index]; }
 
         std::shared_ptr<VM> NewWithGlobalsStore(std::shared_ptr<ByteCode> bc, std::shared_ptr<Globals> s) {
             VM vm(bc);
@@ -74,6 +120,13 @@ namespace monkey {
 
         void Run();
 
+        // 供内置函数回调: 闭包的帧压在当前帧之上, 执行到它返回为止
+        std::shared_ptr<Object> Call(const std::shared_ptr<Object>& fn, ArgsView args) override;
+
+        std::unique_ptr<Caller> NewWorker() override;
+
+        bool ParallelSafe(ArgsView values) override;
+
         void executeBinaryOperation(Opcode op);
 
         void executeBinaryIntegerOperation(Opcode op, std::shared_ptr<Object> left, std::shared_ptr<Object> right);
@@ -98,9 +151,11 @@ namespace monkey {
 
         void executeCall (int numArgs);
 
+        void executeTailCall(int numArgs);
+
         void callFunction(std::shared_ptr<Closure> cl, int numArgs);
 
-        void callBuiltin(std::shared_ptr<Builtin> fn, int numArgs);
+        void callBuiltin(Builtin* fn, int numArgs);
 
         void pushClosure(int constIndex, int numFree);
 
@@ -122,9 +177,28 @@ namespace monkey {
 
         std::shared_ptr<Frame> popFrame();
 
+    private:
+        // 执行指令, 直到帧数降到 exitFrames (从 Call 进入时) 或主程序结束
+        void execute(int exitFrames);
+
+        void useAnchoredObjects(const AnchoredObjects& objects) {
+            constants = objects.constants;
+            True = objects.True;
+            False = objects.False;
+            null = objects.null;
+            builtinFns = objects.builtins;
+            registry = objects.registry;
+        }
+
     private:
         int sp; // Always points to the next value. Top of stack is stack[sp-1]
         std::shared_ptr<Constants> constants;
+        // 与全局的 True/False/null 同名, VM 内部使用的是本 VM 的别名句柄
+        std::shared_ptr<Boolea> True;
+        std::shared_ptr<Boolea> False;
+        std::shared_ptr<Null> null;
+        std::vector<std::shared_ptr<Object>> builtinFns;
+        std::shared_ptr<const BuiltinRegistry> registry;
         Stack stack;
         std::shared_ptr<Globals> globals;
         int framesIndex;
@@ -0,0 +1,156 @@
+#include <iterator>
+
+#include "../include/isolate.h"
+#include "../include/parser.h"
+#include "../include/regcompiler.h"
+#include "../include/regvm.h"
+#include "../include/verifier.h"
+#include "../include/vm.h"
+
+namespace monkey {
+    namespace {
+        // 编译后全局符号表中的所有全局变量
+        std::shared_ptr<const CompiledProgram> withDefinitions(std::shared_ptr<CompiledProgram> program, const SymbolTable& symbols) {
+            for (auto& entry : symbols.GetStore()) {
+                if (entry.second.scope == GlobalScope) {
+                    program->definitions[entry.first] = entry.second.index;
+                }
+            }
+            return program;
+        }
+    } // namespace
+
+    int CompiledProgram::GlobalIndex(const std::string& name) const {
+        for (size_t i = 0; i < globals.size(); ++i) {
+            if (globals[i] == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int CompiledProgram::DefinitionIndex(const std::string& name) const {
+        auto it = definitions.find(name);
+        return it != definitions.end() ? it->second : -1;
+    }
+
+    std::shared_ptr<const CompiledProgram> CompileProgram(const std::string& source, const RunOptions& options,
+                                                          const std::vector<std::string>& globals) {
+        auto builtins = options.builtins != nullptr ? options.builtins : BuiltinRegistry::Default();
+        auto symbolTablePtr = std::make_shared<SymbolTable>();
+        builtins->DefineIn(*symbolTablePtr);
+        for (auto& name : globals) {
+            Symbol symbol;
+            if (symbolTablePtr->Resolve(name, symbol)) {
+                throw CompileError{"global " + name + " is already defined"};
+            }
+            symbolTablePtr->Define(name);
+        }
+
+        auto lexer = std::make_shared<Lexer>(source);
+        auto parser = std::make_shared<Parser>(lexer);
+        auto program = parser->parseProgram();
+        if (parser->getErrors().size() != 0) {
+            throw CompileError{"parser errors:\n" + parser->getErrors()};
+        }
+        if (options.optimizeLevel >= OptimizeDeadCode) {
+            EliminateDeadCode(program, builtins.get());
+        }
+        if (options.backend == Backend::Register) {
+            RegisterCompiler compiler(symbolTablePtr);
+            compiler.Compile(program);
+            auto bytecode = compiler.Bytecode();
+            bytecode->builtins = builtins;
+            return withDefinitions(std::make_shared<CompiledProgram>(bytecode, options.backend, globals), *symbolTablePtr);
+        }
+        Compiler compiler(symbolTablePtr);
+        compiler.Compile(program);
+        auto bytecode = compiler.Bytecode();
+        bytecode->builtins = builtins;
+        OptimizeBytecode(bytecode, options.optimizeLevel);
+        // 校验会写 verified 标记, 必须在程序被多个线程共享之前完成
+        VerifyBytecode(bytecode);
+        return withDefinitions(std::make_shared<CompiledProgram>(bytecode, options.backend, globals), *symbolTablePtr);
+    }
+
+    std::shared_ptr<const CompiledProgram> ProgramCache::Get(const std::string& source, const RunOptions& options) {
+        auto hash = std::hash<std::string>()(source);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto program = find(hash, source, options);
+            if (program != nullptr) {
+                return program;
+            }
+        }
+        auto program = CompileProgram(source, options);
+        std::lock_guard<std::mutex> lock(mutex);
+        // 其他线程可能同时编译了同一个脚本, 以先加入缓存的为准
+        auto cached = find(hash, source, options);
+        if (cached != nullptr) {
+            return cached;
+        }
+        recent.push_front(Entry{hash, source, options.backend, options.optimizeLevel, options.builtins, program});
+        programs.emplace(hash, recent.begin());
+        evict();
+        return program;
+    }
+
+    std::shared_ptr<const CompiledProgram> ProgramCache::find(size_t hash, const std::string& source, const RunOptions& options) {
+        auto range = programs.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            auto& entry = *it->second;
+            if (entry.backend == options.backend && entry.optimizeLevel == options.optimizeLevel
+                    && entry.builtins == options.builtins && entry.source == source) {
+                recent.splice(recent.begin(), recent, it->second);
+                return entry.program;
+            }
+        }
+        return nullptr;
+    }
+
+    void ProgramCache::evict() {
+        while (recent.size() > capacity) {
+            auto oldest = std::prev(recent.end());
+            auto range = programs.equal_range(oldest->hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (it->second == oldest) {
+                    programs.erase(it);
+                    break;
+                }
+            }
+            recent.pop_back();
+        }
+    }
+
+    size_t ProgramCache::Size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return programs.size();
+    }
+
+    void ProgramCache::Clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        programs.clear();
+        recent.clear();
+    }
+
+    void ProgramCache::SetCapacity(size_t capacity) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->capacity = capacity > 0 ? capacity : 1;
+        evict();
+    }
+
+    ProgramCache& ProgramCache::Shared() {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    void Isolate::Run() {
+        if (program->backend == Backend::Register) {
+            RegisterVM vm(program->bytecode);
+            vm.Run();
+            return;
+        }
+        VM vm(program->bytecode);
+        vm.Run();
+    }
+} // namespace monkey
@@ -1,32 +1,132 @@
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <unistd.h>
 
 #include "./utils/timer.h"
 #include "./include/repl.h"
+#include "./include/native.h"
+#include "./include/filter.h"
+#include "./include/output.h"
+#include "./include/parallel.h"
+
+static void usage() {
+    std::cerr << "Usage: ./monkey [run [--stats] [--vm=stack|register] [-O0|-O1|-O2] [--native=lib.so ...] [--threads=N] [--output-buffer=BYTES] [--line-buffered]]"
+              << " or [filter script.mk [--fn=NAME] [--end=NAME] [--batch=N] [--jobs=N] and the options of run] or [cmd]" << std::endl;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: ./monkey [run] or [cmd]" << std::endl;
+    if (argc < 2) {
+        usage();
         return 1;
     }
     std::string arg(argv[1]);
+    monkey::RunOptions options;
+    monkey::FilterOptions filterOptions;
+    std::shared_ptr<monkey::BuiltinRegistry> registry;
+    // filter 的第一个参数是脚本路径
+    std::string script;
+    int firstOption = 2;
+    if (arg == "filter") {
+        if (argc < 3) {
+            usage();
+            return 1;
+        }
+        script = argv[2];
+        firstOption = 3;
+    }
+    for (int i = firstOption; i < argc; ++i) {
+        std::string option(argv[i]);
+        if (option == "--stats") {
+            monkey::runtimeStats.enabled = true;
+        } else if (option == "--vm=stack") {
+            options.backend = monkey::Backend::Stack;
+        } else if (option == "--vm=register") {
+            options.backend = monkey::Backend::Register;
+        } else if (option == "-O0" || option == "-O1" || option == "-O2") {
+            options.optimizeLevel = option[2] - '0';
+        } else if (option.compare(0, 9, "--native=") == 0) {
+            // 所有扩展追加到同一张表中
+            if (registry == nullptr) {
+                registry = std::make_shared<monkey::BuiltinRegistry>();
+                options.builtins = registry;
+            }
+            try {
+                monkey::LoadNativeExtension(*registry, option.substr(9));
+            } catch (std::exception& e) {
+                // monkey 的异常消息自带换行, 扩展抛出的其他异常不一定
+                std::string message = e.what();
+                std::cerr << message;
+                if (message.empty() || message.back() != '\n') {
+                    std::cerr << std::endl;
+                }
+                return 1;
+            }
+        } else if (option.compare(0, 16, "--output-buffer=") == 0) {
+            // print 的缓冲大小 (字节), 0 表示不缓冲
+            monkey::StandardOutput().Configure(std::strtoul(option.c_str() + 16, nullptr, 10), monkey::OutputSink::Buffered);
+        } else if (option == "--line-buffered") {
+            monkey::StandardOutput().Configure(monkey::OutputSink::DefaultCapacity, monkey::OutputSink::LineBuffered);
+        } else if (option.compare(0, 5, "--fn=") == 0) {
+            filterOptions.function = option.substr(5);
+        } else if (option.compare(0, 6, "--end=") == 0) {
+            filterOptions.end = option.substr(6);
+        } else if (option.compare(0, 8, "--batch=") == 0) {
+            filterOptions.batch = std::strtoul(option.c_str() + 8, nullptr, 10);
+        } else if (option.compare(0, 7, "--jobs=") == 0) {
+            filterOptions.jobs = std::strtoul(option.c_str() + 7, nullptr, 10);
+        } else if (option.compare(0, 10, "--threads=") == 0) {
+            // pmap/preduce 使用的线程数
+            monkey::SetParallelWorkers(std::atoi(option.c_str() + 10));
+        } else {
+            std::cerr << "Unknown option: " << option << std::endl;
+            return 1;
+        }
+    }
     if (arg == "run") {
         Timer timer;
         std::ifstream input("input.txt");
         std::ostream output(std::cout.rdbuf());
         bool output_need_print;
-        output_need_print = monkey::start_run(input, output);
+        output_need_print = monkey::start_run(input, output, options);
         input.close();
         std::cout << "\033[32m" << "Elapsed time: " << timer.elapsed() << "s" << "\033[0m" << std::endl;
+        if (monkey::runtimeStats.enabled) {
+            monkey::printStats(std::cout);
+        }
+    } else if (arg == "filter") {
+        // 脚本只编译一次, 之后逐行处理标准输入; 输出只有脚本的结果, 错误写到标准错误
+        std::ifstream input(script);
+        if (!input) {
+            std::cerr << "can not open " << script << std::endl;
+            return 1;
+        }
+        // 与 run 一样跳过 '#' 开头的行
+        std::string source, line;
+        while (std::getline(input, line)) {
+            if (!line.empty() && line[0] == '#') {
+                continue;
+            }
+            source += line;
+            source += '\n';
+        }
+        try {
+            monkey::RunFilter(monkey::CompileProgram(source, options), filterOptions, STDIN_FILENO);
+        } catch (std::exception& e) {
+            monkey::StandardOutput().Flush();
+            std::cerr << e.what();
+            return 1;
+        }
+        monkey::StandardOutput().Flush();
     } else if (arg == "cmd") {
         std::istream input(std::cin.rdbuf());
         std::ostream output(std::cout.rdbuf());
         monkey::start_cmd(input, output);
     } else {
-        std::cerr << "Usage: ./monkey [run] or [cmd]" << std::endl;
+        usage();
         return 1;
     }
 
     return 0;
-}
\ No newline at end of file
+}
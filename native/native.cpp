@@ -0,0 +1,53 @@
+#include <dlfcn.h>
+#include <exception>
+#include <string>
+
+#include "../include/native.h"
+
+namespace monkey {
+    int LoadNativeExtension(BuiltinRegistry& registry, const std::string& path) {
+        // 不带 '/' 的路径 dlopen 只在系统目录中查找, 这里按相对当前目录的路径处理
+        auto file = path.find('/') == std::string::npos ? "./" + path : path;
+        void* handle = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == nullptr) {
+            throw CompileError{"can not load native extension " + path + ": " + dlerror()};
+        }
+        auto init = reinterpret_cast<NativeInitFunction>(dlsym(handle, NativeInitSymbol));
+        if (init == nullptr) {
+            dlclose(handle);
+            throw CompileError{"native extension " + path + " does not export " + NativeInitSymbol};
+        }
+        // 先注册到副本中, 成功后才替换, 失败时 registry 不变且扩展被卸载
+        bool failed = true;
+        std::string error = "failed to initialize";
+        int count = 0;
+        {
+            BuiltinRegistry scratch(registry);
+            try {
+                if (init(&scratch, MONKEY_NATIVE_ABI) != 0) {
+                    error = "failed to initialize (abi " + std::to_string(MONKEY_NATIVE_ABI) + ")";
+                } else {
+                    count = scratch.Size() - registry.Size();
+                    registry = std::move(scratch);
+                    failed = false;
+                }
+            } catch (CompileError& e) {
+                // Register 的错误 (重名或表已满), 去掉前缀后放进本函数的错误中
+                const std::string prefix = "Compile Error: ";
+                error = e.msg.compare(0, prefix.size(), prefix) == 0 ? e.msg.substr(prefix.size()) : e.msg;
+            } catch (std::exception& e) {
+                // 异常对象可能来自扩展, 卸载前只保留消息
+                error = e.what();
+            } catch (...) {
+            }
+        }
+        if (failed) {
+            dlclose(handle);
+            while (!error.empty() && error.back() == '\n') {
+                error.pop_back();
+            }
+            throw CompileError{"native extension " + path + ": " + error};
+        }
+        return count;
+    }
+} // namespace monkey
@@ -0,0 +1,291 @@
+#include <set>
+
+#include "../include/optimizer.h"
+
+namespace monkey {
+    namespace {
+        // 标记为 pure 且参数个数固定的内置函数, 名字被程序中的 let 或参数遮蔽时除外
+        struct PureBuiltins {
+            const BuiltinRegistry* registry = nullptr;
+            std::set<std::string> shadowed;
+
+            bool isPureCall(std::shared_ptr<CallExpression> call_expr) const {
+                auto ident = std::dynamic_pointer_cast<Identifier>(call_expr->function);
+                if (registry == nullptr || ident == nullptr || shadowed.count(ident->value) != 0) {
+                    return false;
+                }
+                int index = registry->Find(ident->value);
+                if (index < 0) {
+                    return false;
+                }
+                auto& fn = (*registry)[index].fn;
+                return fn->pure && fn->arity == static_cast<int>(call_expr->arguments.size());
+            }
+        };
+
+        // 没有副作用且不会出错的表达式, 值不被使用时可以直接删除
+        // 内置函数出错时返回错误对象而不是中止执行, 所以 pure 的内置函数调用也算在内
+        bool isPure(std::shared_ptr<Expression> expr, const PureBuiltins& builtins) {
+            if (std::dynamic_pointer_cast<IntegerLiteral>(expr) || std::dynamic_pointer_cast<StringLiteral>(expr)
+                    || std::dynamic_pointer_cast<Boolean>(expr) || std::dynamic_pointer_cast<FunctionLiteral>(expr)) {
+                return true;
+            }
+            if (std::dynamic_pointer_cast<ArrayLiteral>(expr)) {
+                for (auto& elem : std::dynamic_pointer_cast<ArrayLiteral>(expr)->elements) {
+                    if (!isPure(elem, builtins)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            if (std::dynamic_pointer_cast<PrefixExpression>(expr)) {
+                auto prefix_expr = std::dynamic_pointer_cast<PrefixExpression>(expr);
+                return prefix_expr->op == "!" && isPure(prefix_expr->right, builtins);
+            }
+            if (std::dynamic_pointer_cast<InfixExpression>(expr)) {
+                // 只有 == 和 != 对任意类型都不会报错
+                auto infix_expr = std::dynamic_pointer_cast<InfixExpression>(expr);
+                return (infix_expr->op == "==" || infix_expr->op == "!=") && isPure(infix_expr->left, builtins) && isPure(infix_expr->right, builtins);
+            }
+            if (std::dynamic_pointer_cast<CallExpression>(expr)) {
+                auto call_expr = std::dynamic_pointer_cast<CallExpression>(expr);
+                if (!builtins.isPureCall(call_expr)) {
+                    return false;
+                }
+                for (auto& arg : call_expr->arguments) {
+                    if (!isPure(arg, builtins)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            return false;
+        }
+
+        // 条件是字面量时返回 true, value 为其真假
+        bool literalCondition(std::shared_ptr<Expression> expr, bool& value) {
+            if (std::dynamic_pointer_cast<Boolean>(expr)) {
+                value = std::dynamic_pointer_cast<Boolean>(expr)->value;
+                return true;
+            }
+            if (std::dynamic_pointer_cast<IntegerLiteral>(expr) || std::dynamic_pointer_cast<StringLiteral>(expr)) {
+                value = true;
+                return true;
+            }
+            return false;
+        }
+
+        // 收集 node 中引用 (读取或赋值) 的所有名字, 包括嵌套函数中的引用
+        // defined 不为空时, 同时收集 let, 函数名和参数定义的名字
+        void collectNames(std::shared_ptr<Node> node, std::set<std::string>& names, std::set<std::string>* defined = nullptr) {
+            if (node == nullptr) {
+                return;
+            }
+            if (std::dynamic_pointer_cast<Identifier>(node)) {
+                names.insert(std::dynamic_pointer_cast<Identifier>(node)->value);
+            } else if (std::dynamic_pointer_cast<LetStatement>(node)) {
+                auto let_stmt = std::dynamic_pointer_cast<LetStatement>(node);
+                if (defined != nullptr) {
+                    defined->insert(let_stmt->name->value);
+                }
+                collectNames(let_stmt->value, names, defined);
+            } else if (std::dynamic_pointer_cast<AssignStatement>(node)) {
+                auto assign_stmt = std::dynamic_pointer_cast<AssignStatement>(node);
+                names.insert(assign_stmt->name->value);
+                collectNames(assign_stmt->value, names, defined);
+            } else if (std::dynamic_pointer_cast<ReturnStatement>(node)) {
+                collectNames(std::dynamic_pointer_cast<ReturnStatement>(node)->returnValue, names, defined);
+            } else if (std::dynamic_pointer_cast<ExpressionStatement>(node)) {
+                collectNames(std::dynamic_pointer_cast<ExpressionStatement>(node)->expression, names, defined);
+            } else if (std::dynamic_pointer_cast<BlockStatement>(node)) {
+                for (auto& stmt : std::dynamic_pointer_cast<BlockStatement>(node)->statements) {
+                    collectNames(stmt, names, defined);
+                }
+            } else if (std::dynamic_pointer_cast<PrefixExpression>(node)) {
+                collectNames(std::dynamic_pointer_cast<PrefixExpression>(node)->right, names, defined);
+            } else if (std::dynamic_pointer_cast<InfixExpression>(node)) {
+                auto infix_expr = std::dynamic_pointer_cast<InfixExpression>(node);
+                collectNames(infix_expr->left, names, defined);
+                collectNames(infix_expr->right, names, defined);
+            } else if (std::dynamic_pointer_cast<IfExpression>(node)) {
+                auto if_expr = std::dynamic_pointer_cast<IfExpression>(node);
+                collectNames(if_expr->condition, names, defined);
+                collectNames(if_expr->consequence, names, defined);
+                collectNames(if_expr->alternative, names, defined);
+            } else if (std::dynamic_pointer_cast<WhileExpression>(node)) {
+                auto while_expr = std::dynamic_pointer_cast<WhileExpression>(node);
+                collectNames(while_expr->condition, names, defined);
+                collectNames(while_expr->body, names, defined);
+            } else if (std::dynamic_pointer_cast<ForExpression>(node)) {
+                auto for_expr = std::dynamic_pointer_cast<ForExpression>(node);
+                collectNames(for_expr->init, names, defined);
+                collectNames(for_expr->condition, names, defined);
+                collectNames(for_expr->update, names, defined);
+                collectNames(for_expr->body, names, defined);
+            } else if (std::dynamic_pointer_cast<ArrayLiteral>(node)) {
+                for (auto& elem : std::dynamic_pointer_cast<ArrayLiteral>(node)->elements) {
+                    collectNames(elem, names, defined);
+                }
+            } else if (std::dynamic_pointer_cast<HashLiteral>(node)) {
+                for (auto& pair : std::dynamic_pointer_cast<HashLiteral>(node)->pairs) {
+                    collectNames(pair.first, names, defined);
+                    collectNames(pair.second, names, defined);
+                }
+            } else if (std::dynamic_pointer_cast<IndexExpression>(node)) {
+                auto index_expr = std::dynamic_pointer_cast<IndexExpression>(node);
+                collectNames(index_expr->left, names, defined);
+                collectNames(index_expr->index, names, defined);
+            } else if (std::dynamic_pointer_cast<FunctionLiteral>(node)) {
+                auto func = std::dynamic_pointer_cast<FunctionLiteral>(node);
+                if (defined != nullptr) {
+                    defined->insert(func->name);
+                    for (auto& param : func->parameters) {
+                        defined->insert(param->value);
+                    }
+                }
+                collectNames(func->body, names, defined);
+            } else if (std::dynamic_pointer_cast<CallExpression>(node)) {
+                auto call_expr = std::dynamic_pointer_cast<CallExpression>(node);
+                collectNames(call_expr->function, names, defined);
+                for (auto& arg : call_expr->arguments) {
+                    collectNames(arg, names, defined);
+                }
+            }
+        }
+
+        class DeadCodeEliminator {
+        public:
+            explicit DeadCodeEliminator(const PureBuiltins& builtins) : builtins(builtins) {}
+
+            // keepValue: 最后一条语句是语句块的值 (函数体, if 分支, 顶层程序)
+            void block(std::vector<std::shared_ptr<Statement>>& statements, bool keepValue);
+
+            void statement(std::shared_ptr<Statement> stmt);
+
+            void expression(std::shared_ptr<Expression> expr);
+
+        private:
+            const PureBuiltins& builtins;
+            const std::set<std::string>* used = nullptr;   // 当前函数中被引用的名字, 顶层为 nullptr
+        };
+
+        void DeadCodeEliminator::block(std::vector<std::shared_ptr<Statement>>& statements, bool keepValue) {
+            std::vector<std::shared_ptr<Statement>> live;
+            for (size_t i = 0; i < statements.size(); ++i) {
+                auto stmt = statements[i];
+                bool isValue = keepValue && i + 1 == statements.size();
+                statement(stmt);
+                if (!isValue && std::dynamic_pointer_cast<ExpressionStatement>(stmt)
+                        && isPure(std::dynamic_pointer_cast<ExpressionStatement>(stmt)->expression, builtins)) {
+                    continue;
+                }
+                // 删除最后一条 let 会让前一条语句变成语句块的值, 所以保留
+                auto let_stmt = std::dynamic_pointer_cast<LetStatement>(stmt);
+                if (!isValue && let_stmt != nullptr && used != nullptr
+                        && used->count(let_stmt->name->value) == 0 && isPure(let_stmt->value, builtins)) {
+                    continue;
+                }
+                live.push_back(stmt);
+                if (std::dynamic_pointer_cast<ReturnStatement>(stmt)) {
+                    break;
+                }
+            }
+            statements.swap(live);
+        }
+
+        void DeadCodeEliminator::statement(std::shared_ptr<Statement> stmt) {
+            if (std::dynamic_pointer_cast<LetStatement>(stmt)) {
+                expression(std::dynamic_pointer_cast<LetStatement>(stmt)->value);
+            } else if (std::dynamic_pointer_cast<AssignStatement>(stmt)) {
+                expression(std::dynamic_pointer_cast<AssignStatement>(stmt)->value);
+            } else if (std::dynamic_pointer_cast<ReturnStatement>(stmt)) {
+                expression(std::dynamic_pointer_cast<ReturnStatement>(stmt)->returnValue);
+            } else if (std::dynamic_pointer_cast<ExpressionStatement>(stmt)) {
+                expression(std::dynamic_pointer_cast<ExpressionStatement>(stmt)->expression);
+            } else if (std::dynamic_pointer_cast<BlockStatement>(stmt)) {
+                block(std::dynamic_pointer_cast<BlockStatement>(stmt)->statements, false);
+            }
+        }
+
+        void DeadCodeEliminator::expression(std::shared_ptr<Expression> expr) {
+            if (expr == nullptr) {
+                return;
+            }
+            if (std::dynamic_pointer_cast<PrefixExpression>(expr)) {
+                expression(std::dynamic_pointer_cast<PrefixExpression>(expr)->right);
+            } else if (std::dynamic_pointer_cast<InfixExpression>(expr)) {
+                auto infix_expr = std::dynamic_pointer_cast<InfixExpression>(expr);
+                expression(infix_expr->left);
+                expression(infix_expr->right);
+            } else if (std::dynamic_pointer_cast<IfExpression>(expr)) {
+                auto if_expr = std::dynamic_pointer_cast<IfExpression>(expr);
+                expression(if_expr->condition);
+                bool value;
+                if (literalCondition(if_expr->condition, value)) {
+                    // 只保留会执行的分支, 改写为 if (true) { 分支 }, 编译后的条件判断由窥孔优化删除
+                    auto taken = value ? if_expr->consequence : if_expr->alternative;
+                    if (taken == nullptr) {
+                        taken = std::make_shared<BlockStatement>(Token(TokenType::LBRACE, "{"));
+                    }
+                    if_expr->condition = std::make_shared<Boolean>(Token(TokenType::TRUE, "true"), true);
+                    if_expr->consequence = taken;
+                    if_expr->alternative = nullptr;
+                }
+                block(if_expr->consequence->statements, true);
+                if (if_expr->alternative != nullptr) {
+                    block(if_expr->alternative->statements, true);
+                }
+            } else if (std::dynamic_pointer_cast<WhileExpression>(expr)) {
+                auto while_expr = std::dynamic_pointer_cast<WhileExpression>(expr);
+                expression(while_expr->condition);
+                block(while_expr->body->statements, false);
+            } else if (std::dynamic_pointer_cast<ForExpression>(expr)) {
+                auto for_expr = std::dynamic_pointer_cast<ForExpression>(expr);
+                statement(for_expr->init);
+                expression(for_expr->condition);
+                statement(for_expr->update);
+                block(for_expr->body->statements, false);
+            } else if (std::dynamic_pointer_cast<ArrayLiteral>(expr)) {
+                for (auto& elem : std::dynamic_pointer_cast<ArrayLiteral>(expr)->elements) {
+                    expression(elem);
+                }
+            } else if (std::dynamic_pointer_cast<HashLiteral>(expr)) {
+                for (auto& pair : std::dynamic_pointer_cast<HashLiteral>(expr)->pairs) {
+                    expression(pair.first);
+                    expression(pair.second);
+                }
+            } else if (std::dynamic_pointer_cast<IndexExpression>(expr)) {
+                auto index_expr = std::dynamic_pointer_cast<IndexExpression>(expr);
+                expression(index_expr->left);
+                expression(index_expr->index);
+            } else if (std::dynamic_pointer_cast<FunctionLiteral>(expr)) {
+                auto func = std::dynamic_pointer_cast<FunctionLiteral>(expr);
+                std::set<std::string> names;
+                collectNames(func->body, names);
+                auto outer = used;
+                used = &names;
+                block(func->body->statements, true);
+                used = outer;
+            } else if (std::dynamic_pointer_cast<CallExpression>(expr)) {
+                auto call_expr = std::dynamic_pointer_cast<CallExpression>(expr);
+                expression(call_expr->function);
+                for (auto& arg : call_expr->arguments) {
+                    expression(arg);
+                }
+            }
+        }
+    } // namespace
+
+    void EliminateDeadCode(std::shared_ptr<Program> program, const BuiltinRegistry* builtins) {
+        PureBuiltins pureBuiltins;
+        if (builtins != nullptr) {
+            pureBuiltins.registry = builtins;
+            std::set<std::string> names;
+            for (auto& stmt : program->statements) {
+                collectNames(stmt, names, &pureBuiltins.shadowed);
+            }
+        }
+        DeadCodeEliminator eliminator(pureBuiltins);
+        eliminator.block(program->statements, true);
+    }
+} // namespace monkey
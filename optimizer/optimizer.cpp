@@ -0,0 +1,293 @@
+#include "../include/optimizer.h"
+
+namespace monkey {
+    namespace {
+        struct OptInstruction {
+            Opcode op;
+            std::vector<uint16_t> operands;
+            int target = -1;        // 跳转指令的目标 (指令下标), 可能指向已删除的指令, 由 resolve 修正
+            bool removed = false;
+        };
+
+        bool isJump(Opcode op) {
+            return op == OpJump || op == OpJumpNotTruthy;
+        }
+
+        // 执行后不会落到下一条指令
+        bool isTerminator(Opcode op) {
+            return op == OpJump || op == OpReturnValue || op == OpReturn;
+        }
+
+        // 只压入一个值且没有副作用的指令
+        bool isPureLoad(Opcode op) {
+            switch (op) {
+                case OpConstant:
+                case OpTrue:
+                case OpFalse:
+                case OpNull:
+                case OpGetGlobal:
+                case OpGetLocal:
+                case OpGetFree:
+                case OpGetBuiltin:
+                case OpCurrentClosure:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        class Peephole {
+        public:
+            Peephole(Instructions& ins, bool isMain) : isMain(isMain) {
+                decode(ins);
+            }
+
+            void run(int level) {
+                bool changed = true;
+                while (changed) {
+                    changed = applyRules();
+                    if (level >= OptimizeDeadCode) {
+                        changed = removeUnreachable() || changed;
+                    }
+                }
+            }
+
+            Instructions encode();
+
+        private:
+            void decode(Instructions& ins);
+
+            bool applyRules();
+
+            bool removeUnreachable();
+
+            // i 之后第一条未删除的指令, 没有时返回 code.size()
+            int nextLive(int i) {
+                ++i;
+                while (i < static_cast<int>(code.size()) && code[i].removed) {
+                    ++i;
+                }
+                return i;
+            }
+
+            // 跳转目标可能已被删除, 此时实际跳到其后第一条未删除的指令
+            int resolve(int target) {
+                return target < static_cast<int>(code.size()) && code[target].removed ? nextLive(target) : target;
+            }
+
+            Opcode opAt(int i) {
+                return i < static_cast<int>(code.size()) ? code[i].op : OpNull;
+            }
+
+            bool isLastLive(int i) {
+                return nextLive(i) == static_cast<int>(code.size());
+            }
+
+            // 删除一条指令, 引用它的跳转随之落到下一条未删除的指令
+            void remove(int i) {
+                code[i].removed = true;
+                refs[nextLive(i)] += refs[i];
+                refs[i] = 0;
+            }
+
+        private:
+            std::vector<OptInstruction> code;
+            std::vector<int> refs;  // 每条指令被多少条跳转指令引用, 被引用的指令不能与前一条指令合并
+            bool isMain;
+        };
+
+        void Peephole::decode(Instructions& ins) {
+            std::vector<int> indexOf(ins.size() + 1, -1);
+            for (int offset = 0; offset < static_cast<int>(ins.size());) {
+                auto def = Lookup(ins[offset]);
+                if (def == nullptr) {
+                    throw CodeError{"Unknown opcode in 'OptimizeInstructions()'\n"};
+                }
+                OptInstruction instruction;
+                instruction.op = ins[offset];
+                instruction.operands = ReadOperands(def, ins, offset + 1);
+                indexOf[offset] = code.size();
+                code.push_back(instruction);
+                offset += 1;
+                for (auto width : def->OperandWidths) {
+                    offset += width;
+                }
+            }
+            indexOf[ins.size()] = code.size();
+            for (auto& instruction : code) {
+                if (isJump(instruction.op)) {
+                    auto target = indexOf[instruction.operands[0]];
+                    if (target < 0) {
+                        throw CodeError{"jump into the middle of an instruction in 'OptimizeInstructions()'\n"};
+                    }
+                    instruction.target = target;
+                }
+            }
+        }
+
+        bool Peephole::applyRules() {
+            bool changed = false;
+            int size = code.size();
+            refs.assign(size + 1, 0);
+            for (auto& instruction : code) {
+                if (!instruction.removed && isJump(instruction.op)) {
+                    ++refs[resolve(instruction.target)];
+                }
+            }
+            for (int i = 0; i < size; ++i) {
+                auto& instruction = code[i];
+                if (instruction.removed) {
+                    continue;
+                }
+                int next = nextLive(i);
+                if (isJump(instruction.op)) {
+                    // 跳转链: 目标是无条件跳转时直接跳到最终目标
+                    int target = resolve(instruction.target);
+                    for (int hops = 0; opAt(target) == OpJump && target != i && hops < size; ++hops) {
+                        instruction.target = code[target].target;
+                        target = resolve(instruction.target);
+                        ++refs[target];
+                        changed = true;
+                    }
+                    if (instruction.op == OpJump && (opAt(target) == OpReturnValue || opAt(target) == OpReturn)) {
+                        // 跳到返回指令等价于直接返回
+                        instruction.op = code[target].op;
+                        instruction.operands.clear();
+                        instruction.target = -1;
+                        changed = true;
+                    } else if (target == next) {
+                        // 跳到下一条指令: 无条件跳转可以删除, 条件跳转只剩弹出条件值
+                        if (instruction.op == OpJump) {
+                            remove(i);
+                        } else {
+                            instruction.op = OpPop;
+                            instruction.operands.clear();
+                            instruction.target = -1;
+                        }
+                        changed = true;
+                    }
+                    continue;
+                }
+                if (next == size || refs[next] != 0) {
+                    continue;
+                }
+                auto& following = code[next];
+                if (instruction.op == OpTrue && following.op == OpJumpNotTruthy) {
+                    // 条件恒为真, 永远不会跳转
+                    remove(next);
+                    remove(i);
+                    changed = true;
+                } else if (instruction.op == OpFalse && following.op == OpJumpNotTruthy) {
+                    // 条件恒为假, 总是跳转
+                    instruction.op = OpJump;
+                    instruction.operands = following.operands;
+                    instruction.target = following.target;
+                    remove(next);
+                    changed = true;
+                } else if (isPureLoad(instruction.op) && following.op == OpPop && !(isMain && isLastLive(next))) {
+                    // 压入后立即弹出 (包括 OpSetGlobal x; OpGetGlobal x; OpPop 中的后两条)
+                    remove(next);
+                    remove(i);
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        bool Peephole::removeUnreachable() {
+            int size = code.size();
+            std::vector<bool> reachable(size + 1, false);
+            std::vector<int> worklist;
+            auto mark = [&](int i) {
+                if (!reachable[i]) {
+                    reachable[i] = true;
+                    worklist.push_back(i);
+                }
+            };
+            mark(code.empty() || !code[0].removed ? 0 : nextLive(0));
+            while (!worklist.empty()) {
+                int i = worklist.back();
+                worklist.pop_back();
+                if (i == size) {
+                    continue;
+                }
+                if (isJump(code[i].op)) {
+                    mark(resolve(code[i].target));
+                }
+                if (!isTerminator(code[i].op)) {
+                    mark(nextLive(i));
+                }
+            }
+            bool changed = false;
+            for (int i = 0; i < size; ++i) {
+                if (!code[i].removed && !reachable[i]) {
+                    code[i].removed = true;
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        Instructions Peephole::encode() {
+            int size = code.size();
+            // 每个下标对应的新偏移, 已删除的指令映射到其后第一条未删除指令的偏移
+            std::vector<int> newOffset(size + 1, 0);
+            int offset = 0;
+            for (int i = 0; i < size; ++i) {
+                newOffset[i] = offset;
+                if (!code[i].removed) {
+                    auto def = Lookup(code[i].op);
+                    offset += 1;
+                    for (auto width : def->OperandWidths) {
+                        offset += width;
+                    }
+                }
+            }
+            newOffset[size] = offset;
+
+            Instructions ins;
+            ins.reserve(offset);
+            for (auto& instruction : code) {
+                if (instruction.removed) {
+                    continue;
+                }
+                if (isJump(instruction.op)) {
+                    instruction.operands[0] = static_cast<uint16_t>(newOffset[instruction.target]);
+                }
+                auto bytes = Make(instruction.op, instruction.operands);
+                ins.insert(ins.end(), bytes.begin(), bytes.end());
+            }
+            return ins;
+        }
+    } // namespace
+
+    Instructions OptimizeInstructions(Instructions& ins, int level, bool isMain) {
+        if (level <= OptimizeNone) {
+            return ins;
+        }
+        Peephole peephole(ins, isMain);
+        peephole.run(level);
+        return peephole.encode();
+    }
+
+    void OptimizeBytecode(std::shared_ptr<ByteCode> bytecode, int level, size_t firstConstant) {
+        if (level <= OptimizeNone) {
+            return;
+        }
+        bytecode->instructions = OptimizeInstructions(bytecode->instructions, level, true);
+        bytecode->maxStackDepth = MaxStackDepth(bytecode->instructions);
+        bytecode->verified = false;
+        auto& constants = *bytecode->constants;
+        for (size_t i = firstConstant; i < constants.size(); ++i) {
+            auto fn = std::dynamic_pointer_cast<CompiledFunction>(constants[i]);
+            if (std::dynamic_pointer_cast<Closure>(constants[i])) {
+                fn = std::dynamic_pointer_cast<Closure>(constants[i])->fn;
+            }
+            if (fn != nullptr) {
+                fn->instructions = OptimizeInstructions(fn->instructions, level, false);
+                fn->maxStackDepth = MaxStackDepth(fn->instructions);
+                fn->verified = false;
+            }
+        }
+    }
+} // namespace monkey
@@ -0,0 +1,59 @@
+#include <cstring>
+#include <unistd.h>
+
+#include "../include/output.h"
+
+namespace monkey {
+    OutputSink::OutputSink(FILE* file, size_t capacity, Mode mode) : file(file), capacity(0), mode(Buffered) {
+        Configure(capacity, mode);
+    }
+
+    OutputSink::~OutputSink() {
+        Flush();
+    }
+
+    void OutputSink::Write(const char* data, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (mode == Unbuffered || buffer.size() + size > capacity) {
+            flushLocked();
+            // 放不进缓冲区的大块直接写出
+            if (mode == Unbuffered || size > capacity) {
+                std::fwrite(data, 1, size, file);
+                std::fflush(file);
+                return;
+            }
+        }
+        buffer.append(data, size);
+        if (buffer.size() == capacity || (mode == LineBuffered && std::memchr(data, '\n', size) != nullptr)) {
+            flushLocked();
+        }
+    }
+
+    void OutputSink::Flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushLocked();
+    }
+
+    void OutputSink::Configure(size_t capacity, Mode mode) {
+        std::lock_guard<std::mutex> lock(mutex);
+        flushLocked();
+        this->capacity = capacity;
+        this->mode = capacity == 0 ? Unbuffered : mode;
+        buffer.reserve(capacity);
+    }
+
+    void OutputSink::flushLocked() {
+        if (!buffer.empty()) {
+            std::fwrite(buffer.data(), 1, buffer.size(), file);
+            buffer.clear();
+        }
+        std::fflush(file);
+    }
+
+    OutputSink& StandardOutput() {
+        // 静态对象在 exit 时析构, 写出剩余内容
+        static OutputSink sink(stdout, OutputSink::DefaultCapacity,
+                               isatty(STDOUT_FILENO) ? OutputSink::LineBuffered : OutputSink::Buffered);
+        return sink;
+    }
+} // namespace monkey
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include "../include/parallel.h"
+#include "../include/builtins.h"
+
+namespace monkey {
+    namespace {
+        std::atomic<int> configuredWorkers(0);
+
+        // 正在执行 ParallelFor 的任务: 嵌套调用直接在当前线程顺序执行
+        thread_local bool inParallel = false;
+
+        // 进程内共享的线程池: 线程按需启动, 空闲时等待新的任务, 直到进程退出
+        class ThreadPool {
+        public:
+            // 保证至少有 threads 个线程后提交任务
+            void Submit(std::function<void()> job, int threads) {
+                std::lock_guard<std::mutex> lock(mutex);
+                while (started < threads) {
+                    std::thread([this] { loop(); }).detach();
+                    ++started;
+                }
+                jobs.push_back(std::move(job));
+                ready.notify_one();
+            }
+
+            // 线程在进程退出时仍在等待, 所以线程池不析构
+            static ThreadPool& Shared() {
+                static ThreadPool* pool = new ThreadPool();
+                return *pool;
+            }
+
+        private:
+            void loop() {
+                inParallel = true;
+                while (true) {
+                    std::function<void()> job;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        ready.wait(lock, [this] { return !jobs.empty(); });
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    job();
+                }
+            }
+
+            std::mutex mutex;
+            std::condition_variable ready;
+            std::deque<std::function<void()>> jobs;
+            int started = 0;
+        };
+
+        // 一个线程的任务队列: 自己从头部取, 其他线程从尾部窃取
+        struct WorkQueue {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+
+        // 一次 ParallelFor 的共享状态. 线程池中的线程可能在 ParallelFor 返回后才开始,
+        // 它们只持有这个状态, 看到 closed 后直接退出, 不会再碰调用者的 VM
+        struct ParallelState {
+            std::function<void(Caller&, size_t)> task;
+            std::vector<std::unique_ptr<Caller>> callers;   // 下标 0 (当前线程) 不用
+            std::vector<WorkQueue> queues;
+            std::atomic<bool> failed;
+            std::mutex mutex;
+            std::condition_variable finished;
+            int running = 0;
+            bool closed = false;
+            std::exception_ptr error;
+
+            ParallelState(size_t workers) : callers(workers), queues(workers), failed(false) {}
+
+            bool take(size_t worker, size_t& index) {
+                {
+                    auto& own = queues[worker];
+                    std::lock_guard<std::mutex> lock(own.mutex);
+                    if (!own.tasks.empty()) {
+                        index = own.tasks.front();
+                        own.tasks.pop_front();
+                        return true;
+                    }
+                }
+                for (size_t i = 1; i < queues.size(); ++i) {
+                    auto& victim = queues[(worker + i) % queues.size()];
+                    std::lock_guard<std::mutex> lock(victim.mutex);
+                    if (!victim.tasks.empty()) {
+                        index = victim.tasks.back();
+                        victim.tasks.pop_back();
+                        return true;
+                    }
+                }
+                return false;
+            }
+
+            void work(size_t worker, Caller& caller) {
+                size_t index;
+                while (!failed && take(worker, index)) {
+                    try {
+                        task(caller, index);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) {
+                            error = std::current_exception();
+                        }
+                        failed = true;
+                    }
+                }
+            }
+        };
+
+        // 只通过回调产生副作用的内置函数, 回调本身另外检查
+        bool onlyCallsBack(const Builtin& builtin) {
+            return builtin.fn == map || builtin.fn == filter || builtin.fn == reduce || builtin.fn == each
+                || builtin.fn == pmap || builtin.fn == preduce || builtin.fn == sort;
+        }
+    } // namespace
+
+    void SetParallelWorkers(int n) {
+        configuredWorkers = n > 0 ? n : 0;
+    }
+
+    int ParallelWorkers() {
+        int n = configuredWorkers;
+        if (n > 0) {
+            return n;
+        }
+        return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    bool IsParallelSafe(ArgsView values, const EffectsDecoder& decode, const Constants& constants,
+                        const Globals& globals, const std::vector<std::shared_ptr<Object>>& builtins) {
+        std::unordered_set<Object*> visited;
+        std::vector<Object*> pending;
+        auto visit = [&](Object* value) {
+            if (value != nullptr && visited.insert(value).second) {
+                pending.push_back(value);
+            }
+        };
+        for (auto& value : values) {
+            visit(value.get());
+        }
+        while (!pending.empty()) {
+            auto value = pending.back();
+            pending.pop_back();
+            if (auto builtin = dynamic_cast<Builtin*>(value)) {
+                if (!builtin->pure && !onlyCallsBack(*builtin)) {
+                    return false;
+                }
+            } else if (auto cl = dynamic_cast<Closure*>(value)) {
+                visit(cl->fn.get());
+                for (auto& free : cl->free) {
+                    visit(free.get());
+                }
+            } else if (auto fn = dynamic_cast<CompiledFunction*>(value)) {
+                FunctionEffects effects;
+                decode(*fn, effects);
+                if (effects.setsGlobal) {
+                    return false;
+                }
+                for (auto index : effects.globals) {
+                    if (index >= 0 && static_cast<size_t>(index) < globals.size()) {
+                        visit(globals[index].get());
+                    }
+                }
+                for (auto index : effects.builtins) {
+                    if (index >= 0 && static_cast<size_t>(index) < builtins.size()) {
+                        visit(builtins[index].get());
+                    }
+                }
+                for (auto index : effects.functions) {
+                    if (index >= 0 && static_cast<size_t>(index) < constants.size()) {
+                        visit(constants[index].get());
+                    }
+                }
+            } else if (dynamic_cast<Iterator*>(value)) {
+                // 遍历会推进迭代器, 即使通过 map 等只调用回调的内置函数
+                return false;
+            } else if (auto arr = dynamic_cast<Array*>(value)) {
+                for (auto& e : arr->elements) {
+                    visit(e.get());
+                }
+            } else if (auto hash = dynamic_cast<HashTable*>(value)) {
+                for (auto& pair : hash->pairs) {
+                    visit(pair.second->value.get());
+                }
+            }
+        }
+        return true;
+    }
+
+    void ParallelFor(Caller& self, size_t count, const std::function<void(Caller& caller, size_t index)>& task) {
+        size_t workers = std::min(static_cast<size_t>(ParallelWorkers()), count);
+        if (workers <= 1 || inParallel) {
+            for (size_t i = 0; i < count; ++i) {
+                task(self, i);
+            }
+            return;
+        }
+        auto state = std::make_shared<ParallelState>(workers);
+        state->task = task;
+        for (size_t w = 1; w < workers; ++w) {
+            state->callers[w] = self.NewWorker();
+            if (state->callers[w] == nullptr) {
+                workers = w;
+                break;
+            }
+        }
+        // 每个线程先分到连续的一段
+        for (size_t i = 0; i < count; ++i) {
+            state->queues[i * workers / count].tasks.push_back(i);
+        }
+        for (size_t w = 1; w < workers; ++w) {
+            ThreadPool::Shared().Submit([state, w] {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (state->closed) {
+                        return;
+                    }
+                    ++state->running;
+                }
+                state->work(w, *state->callers[w]);
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (--state->running == 0) {
+                    state->finished.notify_all();
+                }
+            }, static_cast<int>(workers) - 1);
+        }
+        inParallel = true;
+        state->work(0, self);
+        inParallel = false;
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->closed = true;
+        state->finished.wait(lock, [&] { return state->running == 0; });
+        // 状态可能在其他线程中才释放, 异常不能留在其中
+        std::exception_ptr error;
+        std::swap(error, state->error);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+} // namespace monkey
@@ -1,6 +1,19 @@
 #include "../include/parser.h"
 
 namespace monkey{
+const std::map<TokenType, prec> precedences = {
+    {TokenType::EQ, prec::EQUALS},
+    {TokenType::NOT_EQ, prec::EQUALS},
+    {TokenType::LT, prec::LESSGREATER},
+    {TokenType::GT, prec::LESSGREATER},
+    {TokenType::PLUS, prec::SUM},
+    {TokenType::MINUS, prec::SUM},
+    {TokenType::SLASH, prec::PRODUCT},
+    {TokenType::ASTERISK, prec::PRODUCT},
+    {TokenType::LPAREN, prec::CALL},
+    {TokenType::LBRACKET, prec::INDEX}
+};
+
 // token 操作
 void Parser::nextToken(){
     curToken = peekToken;
@@ -73,6 +86,11 @@ std::shared_ptr<Statement> Parser::parseStatement(){
             return parseLetStatement();
         case TokenType::RETURN:
             return parseReturnStatement();
+        case TokenType::IDENT:
+            if (peekTokenIs(TokenType::ASSIGN)){
+                return parseAssignStatement();
+            }
+            return parseExpressionStatement();
         default:
             return parseExpressionStatement();
     }
@@ -111,6 +129,21 @@ std::shared_ptr<ReturnStatement> Parser::parseReturnStatement(){
     return stmt;
 }
 
+// 解析赋值语句
+std::shared_ptr<AssignStatement> Parser::parseAssignStatement(){
+    std::shared_ptr<AssignStatement> stmt = std::make_shared<AssignStatement>(curToken);
+    stmt->name = std::make_shared<Identifier>(curToken, curToken.getLiteral());
+    if (!expectPeek(TokenType::ASSIGN)){
+        return nullptr;
+    }
+    nextToken();
+    stmt->value = parseExpression(prec::LOWEST);
+    if (peekTokenIs(TokenType::SEMICOLON)){
+        nextToken();
+    }
+    return stmt;
+}
+
 // 解析表达式语句
 std::shared_ptr<ExpressionStatement> Parser::parseExpressionStatement(){
     std::shared_ptr<ExpressionStatement> stmt = std::make_shared<ExpressionStatement>(curToken);
@@ -148,7 +181,7 @@ std::shared_ptr<Expression> Parser::parseIdentifier(){
 // 解析整型字面量
 std::shared_ptr<Expression> Parser::parseIntegerLiteral(){
     std::shared_ptr<IntegerLiteral> lit = std::make_shared<IntegerLiteral>(curToken);
-    int value = std::stoi(curToken.getLiteral());
+    int64_t value = std::stoll(curToken.getLiteral());
     if (value == 0 && (curToken.getLiteral() != "0")) {
         std::string msg = "could not parse " + curToken.getLiteral() + " as integer";
         errors.emplace_back(msg);
@@ -279,6 +312,58 @@ std::shared_ptr<Expression> Parser::parseIfExpression(){
     return exp;
 }
 
+// 解析 while 循环
+std::shared_ptr<Expression> Parser::parseWhileExpression(){
+    std::shared_ptr<WhileExpression> exp = std::make_shared<WhileExpression>(curToken);
+    if (!expectPeek(TokenType::LPAREN)){
+        return nullptr;
+    }
+    nextToken();
+    exp->condition = parseExpression(prec::LOWEST);
+    if (!expectPeek(TokenType::RPAREN)){
+        return nullptr;
+    }
+    if (!expectPeek(TokenType::LBRACE)){
+        return nullptr;
+    }
+    exp->body = parseBlockStatement();
+    return exp;
+}
+
+// 解析 for 循环
+std::shared_ptr<Expression> Parser::parseForExpression(){
+    std::shared_ptr<ForExpression> exp = std::make_shared<ForExpression>(curToken);
+    if (!expectPeek(TokenType::LPAREN)){
+        return nullptr;
+    }
+    nextToken();
+    exp->init = parseStatement();
+    if (exp->init == nullptr){
+        return nullptr;
+    }
+    if (!curTokenIs(TokenType::SEMICOLON) && !expectPeek(TokenType::SEMICOLON)){
+        return nullptr;
+    }
+    nextToken();
+    exp->condition = parseExpression(prec::LOWEST);
+    if (!expectPeek(TokenType::SEMICOLON)){
+        return nullptr;
+    }
+    nextToken();
+    exp->update = parseStatement();
+    if (exp->update == nullptr){
+        return nullptr;
+    }
+    if (!expectPeek(TokenType::RPAREN)){
+        return nullptr;
+    }
+    if (!expectPeek(TokenType::LBRACE)){
+        return nullptr;
+    }
+    exp->body = parseBlockStatement();
+    return exp;
+}
+
 // 解析块语句
 std::shared_ptr<BlockStatement> Parser::parseBlockStatement(){
     std::shared_ptr<BlockStatement> block = std::make_shared<BlockStatement>(curToken);
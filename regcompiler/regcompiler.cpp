@@ -0,0 +1,547 @@
+#include "../include/regcompiler.h"
+
+namespace monkey {
+    int CountLocalDefinitions(std::shared_ptr<Node> node) {
+        if (node == nullptr) {
+            return 0;
+        }
+        int count = 0;
+        if (std::dynamic_pointer_cast<LetStatement>(node)) {
+            auto let_stmt = std::dynamic_pointer_cast<LetStatement>(node);
+            count = 1 + CountLocalDefinitions(let_stmt->value);
+        } else if (std::dynamic_pointer_cast<AssignStatement>(node)) {
+            count = CountLocalDefinitions(std::dynamic_pointer_cast<AssignStatement>(node)->value);
+        } else if (std::dynamic_pointer_cast<ReturnStatement>(node)) {
+            count = CountLocalDefinitions(std::dynamic_pointer_cast<ReturnStatement>(node)->returnValue);
+        } else if (std::dynamic_pointer_cast<ExpressionStatement>(node)) {
+            count = CountLocalDefinitions(std::dynamic_pointer_cast<ExpressionStatement>(node)->expression);
+        } else if (std::dynamic_pointer_cast<BlockStatement>(node)) {
+            for (auto& stmt : std::dynamic_pointer_cast<BlockStatement>(node)->statements) {
+                count += CountLocalDefinitions(stmt);
+            }
+        } else if (std::dynamic_pointer_cast<PrefixExpression>(node)) {
+            count = CountLocalDefinitions(std::dynamic_pointer_cast<PrefixExpression>(node)->right);
+        } else if (std::dynamic_pointer_cast<InfixExpression>(node)) {
+            auto infix_expr = std::dynamic_pointer_cast<InfixExpression>(node);
+            count = CountLocalDefinitions(infix_expr->left) + CountLocalDefinitions(infix_expr->right);
+        } else if (std::dynamic_pointer_cast<IfExpression>(node)) {
+            auto if_expr = std::dynamic_pointer_cast<IfExpression>(node);
+            count = CountLocalDefinitions(if_expr->condition) + CountLocalDefinitions(if_expr->consequence)
+                    + CountLocalDefinitions(if_expr->alternative);
+        } else if (std::dynamic_pointer_cast<WhileExpression>(node)) {
+            auto while_expr = std::dynamic_pointer_cast<WhileExpression>(node);
+            count = CountLocalDefinitions(while_expr->condition) + CountLocalDefinitions(while_expr->body);
+        } else if (std::dynamic_pointer_cast<ForExpression>(node)) {
+            auto for_expr = std::dynamic_pointer_cast<ForExpression>(node);
+            count = CountLocalDefinitions(for_expr->init) + CountLocalDefinitions(for_expr->condition)
+                    + CountLocalDefinitions(for_expr->update) + CountLocalDefinitions(for_expr->body);
+        } else if (std::dynamic_pointer_cast<ArrayLiteral>(node)) {
+            for (auto& elem : std::dynamic_pointer_cast<ArrayLiteral>(node)->elements) {
+                count += CountLocalDefinitions(elem);
+            }
+        } else if (std::dynamic_pointer_cast<HashLiteral>(node)) {
+            for (auto& pair : std::dynamic_pointer_cast<HashLiteral>(node)->pairs) {
+                count += CountLocalDefinitions(pair.first) + CountLocalDefinitions(pair.second);
+            }
+        } else if (std::dynamic_pointer_cast<IndexExpression>(node)) {
+            auto index_expr = std::dynamic_pointer_cast<IndexExpression>(node);
+            count = CountLocalDefinitions(index_expr->left) + CountLocalDefinitions(index_expr->index);
+        } else if (std::dynamic_pointer_cast<CallExpression>(node)) {
+            auto call_expr = std::dynamic_pointer_cast<CallExpression>(node);
+            count = CountLocalDefinitions(call_expr->function);
+            for (auto& arg : call_expr->arguments) {
+                count += CountLocalDefinitions(arg);
+            }
+        }
+        return count;
+    }
+
+    // node 中是否有给 name 赋值的语句 (不进入嵌套函数, 函数不能给外层的局部变量赋值)
+    static bool assignsVariable(std::shared_ptr<Node> node, const std::string& name) {
+        if (node == nullptr) {
+            return false;
+        }
+        if (std::dynamic_pointer_cast<AssignStatement>(node)) {
+            auto assign_stmt = std::dynamic_pointer_cast<AssignStatement>(node);
+            return assign_stmt->name->value == name || assignsVariable(assign_stmt->value, name);
+        } else if (std::dynamic_pointer_cast<LetStatement>(node)) {
+            return assignsVariable(std::dynamic_pointer_cast<LetStatement>(node)->value, name);
+        } else if (std::dynamic_pointer_cast<ReturnStatement>(node)) {
+            return assignsVariable(std::dynamic_pointer_cast<ReturnStatement>(node)->returnValue, name);
+        } else if (std::dynamic_pointer_cast<ExpressionStatement>(node)) {
+            return assignsVariable(std::dynamic_pointer_cast<ExpressionStatement>(node)->expression, name);
+        } else if (std::dynamic_pointer_cast<BlockStatement>(node)) {
+            for (auto& stmt : std::dynamic_pointer_cast<BlockStatement>(node)->statements) {
+                if (assignsVariable(stmt, name)) {
+                    return true;
+                }
+            }
+        } else if (std::dynamic_pointer_cast<PrefixExpression>(node)) {
+            return assignsVariable(std::dynamic_pointer_cast<PrefixExpression>(node)->right, name);
+        } else if (std::dynamic_pointer_cast<InfixExpression>(node)) {
+            auto infix_expr = std::dynamic_pointer_cast<InfixExpression>(node);
+            return assignsVariable(infix_expr->left, name) || assignsVariable(infix_expr->right, name);
+        } else if (std::dynamic_pointer_cast<IfExpression>(node)) {
+            auto if_expr = std::dynamic_pointer_cast<IfExpression>(node);
+            return assignsVariable(if_expr->condition, name) || assignsVariable(if_expr->consequence, name)
+                   || assignsVariable(if_expr->alternative, name);
+        } else if (std::dynamic_pointer_cast<WhileExpression>(node)) {
+            auto while_expr = std::dynamic_pointer_cast<WhileExpression>(node);
+            return assignsVariable(while_expr->condition, name) || assignsVariable(while_expr->body, name);
+        } else if (std::dynamic_pointer_cast<ForExpression>(node)) {
+            auto for_expr = std::dynamic_pointer_cast<ForExpression>(node);
+            return assignsVariable(for_expr->init, name) || assignsVariable(for_expr->condition, name)
+                   || assignsVariable(for_expr->update, name) || assignsVariable(for_expr->body, name);
+        } else if (std::dynamic_pointer_cast<ArrayLiteral>(node)) {
+            for (auto& elem : std::dynamic_pointer_cast<ArrayLiteral>(node)->elements) {
+                if (assignsVariable(elem, name)) {
+                    return true;
+                }
+            }
+        } else if (std::dynamic_pointer_cast<HashLiteral>(node)) {
+            for (auto& pair : std::dynamic_pointer_cast<HashLiteral>(node)->pairs) {
+                if (assignsVariable(pair.first, name) || assignsVariable(pair.second, name)) {
+                    return true;
+                }
+            }
+        } else if (std::dynamic_pointer_cast<IndexExpression>(node)) {
+            auto index_expr = std::dynamic_pointer_cast<IndexExpression>(node);
+            return assignsVariable(index_expr->left, name) || assignsVariable(index_expr->index, name);
+        } else if (std::dynamic_pointer_cast<CallExpression>(node)) {
+            auto call_expr = std::dynamic_pointer_cast<CallExpression>(node);
+            if (assignsVariable(call_expr->function, name)) {
+                return true;
+            }
+            for (auto& arg : call_expr->arguments) {
+                if (assignsVariable(arg, name)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // 先求值的操作数是变量, 后求值的 later 又给它赋值: 局部变量本身就是操作数寄存器, 必须先复制一份
+    static bool assignedLater(std::shared_ptr<Expression> expr, std::shared_ptr<Expression> later) {
+        auto ident = std::dynamic_pointer_cast<Identifier>(expr);
+        return ident != nullptr && assignsVariable(later, ident->value);
+    }
+
+    // 条件恒为真 (死代码删除把条件为字面量的 if 改写成 if (true) { 分支 })
+    static bool isTrueLiteral(std::shared_ptr<Expression> expr) {
+        auto boolean = std::dynamic_pointer_cast<Boolean>(expr);
+        return boolean != nullptr && boolean->value;
+    }
+
+    void RegisterCompiler::Compile(std::shared_ptr<Program> program) {
+        for (auto& stmt : program->statements) {
+            compileStatement(stmt);
+        }
+        emit(ROpReturnNull);
+    }
+
+    void RegisterCompiler::patchJump(int pc, int targetPc) {
+        auto& ins = scopes.back().instructions;
+        auto instruction = ReadRegInstruction(ins.data(), pc);
+        if (instruction.op == ROpJump) {
+            instruction.a = static_cast<uint16_t>(targetPc);
+        } else {
+            instruction.b = static_cast<uint16_t>(targetPc);
+        }
+        std::memcpy(&ins[pc * RegInstructionSize], &instruction, RegInstructionSize);
+    }
+
+    void RegisterCompiler::compileStatement(std::shared_ptr<Statement> stmt) {
+        auto mark = registerMark();
+        if (std::dynamic_pointer_cast<LetStatement>(stmt)) {
+            auto let_stmt = std::dynamic_pointer_cast<LetStatement>(stmt);
+            auto symbol = symbolTable->Define(let_stmt->name->value);
+            if (symbol.scope == LocalScope) {
+                compileExpression(let_stmt->value, symbol.index);
+            } else {
+                storeSymbol(symbol, compileExpression(let_stmt->value, -1));
+            }
+        } else if (std::dynamic_pointer_cast<AssignStatement>(stmt)) {
+            auto assign_stmt = std::dynamic_pointer_cast<AssignStatement>(stmt);
+            Symbol symbol;
+            if (!symbolTable->Resolve(assign_stmt->name->value, symbol)) {
+                throw CompileError{"undefined variable " + assign_stmt->name->value};
+            }
+            if (symbol.scope == LocalScope) {
+                compileExpression(assign_stmt->value, symbol.index);
+            } else if (symbol.scope == GlobalScope) {
+                storeSymbol(symbol, compileExpression(assign_stmt->value, -1));
+            } else {
+                throw CompileError{"cannot assign to " + symbol.scope + " variable " + symbol.name};
+            }
+        } else if (std::dynamic_pointer_cast<ReturnStatement>(stmt)) {
+            auto return_stmt = std::dynamic_pointer_cast<ReturnStatement>(stmt);
+            if (scopes.size() > 1) {
+                compileReturnValue(return_stmt->returnValue);
+            } else {
+                emit(ROpReturn, compileExpression(return_stmt->returnValue, -1));
+            }
+        } else if (std::dynamic_pointer_cast<ExpressionStatement>(stmt)) {
+            auto expr_stmt = std::dynamic_pointer_cast<ExpressionStatement>(stmt);
+            compileExpression(expr_stmt->expression, -1);
+        } else if (std::dynamic_pointer_cast<BlockStatement>(stmt)) {
+            for (auto& s : std::dynamic_pointer_cast<BlockStatement>(stmt)->statements) {
+                compileStatement(s);
+            }
+        } else {
+            throw CompileError{"unknown node type " + stmt->String()};
+        }
+        freeRegisters(mark);
+    }
+
+    void RegisterCompiler::compileReturnValue(std::shared_ptr<Expression> expr) {
+        if (std::dynamic_pointer_cast<CallExpression>(expr)) {
+            compileCall(std::dynamic_pointer_cast<CallExpression>(expr), -1, true);
+            return;
+        }
+        if (std::dynamic_pointer_cast<IfExpression>(expr)) {
+            // 每个分支各自返回, 省去跳转到公共出口
+            auto if_expr = std::dynamic_pointer_cast<IfExpression>(expr);
+            if (isTrueLiteral(if_expr->condition)) {
+                compileReturnBlock(if_expr->consequence);
+                return;
+            }
+            auto mark = registerMark();
+            auto cond = compileExpression(if_expr->condition, -1);
+            freeRegisters(mark);
+            auto jumpNotTruthyPc = emit(ROpJumpNotTruthy, cond, 0);
+            compileReturnBlock(if_expr->consequence);
+            patchJump(jumpNotTruthyPc, currentPc());
+            if (if_expr->alternative == nullptr) {
+                emit(ROpReturnNull);
+            } else {
+                compileReturnBlock(if_expr->alternative);
+            }
+            return;
+        }
+        auto mark = registerMark();
+        emit(ROpReturn, compileExpression(expr, -1));
+        freeRegisters(mark);
+    }
+
+    void RegisterCompiler::compileReturnBlock(std::shared_ptr<BlockStatement> block) {
+        auto& statements = block->statements;
+        for (size_t i = 0; i + 1 < statements.size(); ++i) {
+            compileStatement(statements[i]);
+        }
+        if (statements.empty()) {
+            emit(ROpReturnNull);
+            return;
+        }
+        auto last = statements.back();
+        if (std::dynamic_pointer_cast<ExpressionStatement>(last)) {
+            compileReturnValue(std::dynamic_pointer_cast<ExpressionStatement>(last)->expression);
+        } else if (std::dynamic_pointer_cast<ReturnStatement>(last)) {
+            compileStatement(last);
+        } else {
+            compileStatement(last);
+            emit(ROpReturnNull);
+        }
+    }
+
+    void RegisterCompiler::compileBlockValue(std::shared_ptr<BlockStatement> block, int dest) {
+        auto& statements = block->statements;
+        for (size_t i = 0; i + 1 < statements.size(); ++i) {
+            compileStatement(statements[i]);
+        }
+        if (!statements.empty() && std::dynamic_pointer_cast<ExpressionStatement>(statements.back())) {
+            auto mark = registerMark();
+            compileExpression(std::dynamic_pointer_cast<ExpressionStatement>(statements.back())->expression, dest);
+            freeRegisters(mark);
+            return;
+        }
+        if (!statements.empty()) {
+            compileStatement(statements.back());
+        }
+        emit(ROpLoadNull, dest);
+    }
+
+    int RegisterCompiler::compileOperand(std::shared_ptr<Expression> expr) {
+        std::shared_ptr<Object> constant;
+        if (std::dynamic_pointer_cast<IntegerLiteral>(expr)) {
+            constant = std::make_shared<Integer>(std::dynamic_pointer_cast<IntegerLiteral>(expr)->value);
+        } else if (std::dynamic_pointer_cast<StringLiteral>(expr)) {
+            constant = std::make_shared<Strin>(std::dynamic_pointer_cast<StringLiteral>(expr)->value);
+        }
+        if (constant != nullptr && constants->size() < RegConstantBit) {
+            return addConstant(constant) | RegConstantBit;
+        }
+        return compileExpression(expr, -1);
+    }
+
+    int RegisterCompiler::compileExpression(std::shared_ptr<Expression> expr, int dest) {
+        if (std::dynamic_pointer_cast<Identifier>(expr)) {
+            auto ident = std::dynamic_pointer_cast<Identifier>(expr);
+            Symbol symbol;
+            if (!symbolTable->Resolve(ident->value, symbol)) {
+                throw CompileError{"undefined variable " + ident->value};
+            }
+            // 局部变量本身就在寄存器中, 不需要移动
+            if (symbol.scope == LocalScope && dest < 0) {
+                return symbol.index;
+            }
+            auto reg = target(dest);
+            loadSymbol(symbol, reg);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<IntegerLiteral>(expr)) {
+            auto reg = target(dest);
+            auto integer = std::make_shared<Integer>(std::dynamic_pointer_cast<IntegerLiteral>(expr)->value);
+            emit(ROpLoadConstant, reg, addConstant(integer));
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<StringLiteral>(expr)) {
+            auto reg = target(dest);
+            auto str = std::make_shared<Strin>(std::dynamic_pointer_cast<StringLiteral>(expr)->value);
+            emit(ROpLoadConstant, reg, addConstant(str));
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<Boolean>(expr)) {
+            auto reg = target(dest);
+            emit(std::dynamic_pointer_cast<Boolean>(expr)->value ? ROpLoadTrue : ROpLoadFalse, reg);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<PrefixExpression>(expr)) {
+            auto prefix_expr = std::dynamic_pointer_cast<PrefixExpression>(expr);
+            Opcode op;
+            if (prefix_expr->op == "!") {
+                op = ROpBang;
+            } else if (prefix_expr->op == "-") {
+                op = ROpMinus;
+            } else {
+                throw CompileError{"unknown operator " + prefix_expr->op};
+            }
+            auto mark = registerMark();
+            auto right = compileExpression(prefix_expr->right, -1);
+            freeRegisters(mark);
+            auto reg = target(dest);
+            emit(op, reg, right);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<InfixExpression>(expr)) {
+            auto infix_expr = std::dynamic_pointer_cast<InfixExpression>(expr);
+            auto left_expr = infix_expr->left;
+            auto right_expr = infix_expr->right;
+            Opcode op;
+            if (infix_expr->op == "+") {
+                op = ROpAdd;
+            } else if (infix_expr->op == "-") {
+                op = ROpSub;
+            } else if (infix_expr->op == "*") {
+                op = ROpMul;
+            } else if (infix_expr->op == "/") {
+                op = ROpDiv;
+            } else if (infix_expr->op == "==") {
+                op = ROpEqual;
+            } else if (infix_expr->op == "!=") {
+                op = ROpNotEqual;
+            } else if (infix_expr->op == ">") {
+                op = ROpGreaterThan;
+            } else if (infix_expr->op == "<") {
+                op = ROpGreaterThan;
+                std::swap(left_expr, right_expr);
+            } else {
+                throw CompileError{"unknown operator " + infix_expr->op};
+            }
+            auto mark = registerMark();
+            auto left = assignedLater(left_expr, right_expr) ? compileExpression(left_expr, allocRegister())
+                                                             : compileOperand(left_expr);
+            auto right = compileOperand(right_expr);
+            // 操作数在写入结果之前读取, 结果可以复用操作数的临时寄存器
+            freeRegisters(mark);
+            auto reg = target(dest);
+            emit(op, reg, left, right);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<IfExpression>(expr)) {
+            auto if_expr = std::dynamic_pointer_cast<IfExpression>(expr);
+            auto reg = target(dest);
+            if (isTrueLiteral(if_expr->condition)) {
+                compileBlockValue(if_expr->consequence, reg);
+                return reg;
+            }
+            auto mark = registerMark();
+            auto cond = compileExpression(if_expr->condition, -1);
+            freeRegisters(mark);
+            auto jumpNotTruthyPc = emit(ROpJumpNotTruthy, cond, 0);
+            compileBlockValue(if_expr->consequence, reg);
+            auto jumpPc = emit(ROpJump, 0);
+            patchJump(jumpNotTruthyPc, currentPc());
+            if (if_expr->alternative == nullptr) {
+                emit(ROpLoadNull, reg);
+            } else {
+                compileBlockValue(if_expr->alternative, reg);
+            }
+            patchJump(jumpPc, currentPc());
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<WhileExpression>(expr)) {
+            auto while_expr = std::dynamic_pointer_cast<WhileExpression>(expr);
+            auto loopStartPc = currentPc();
+            auto mark = registerMark();
+            auto cond = compileExpression(while_expr->condition, -1);
+            freeRegisters(mark);
+            auto exitJumpPc = emit(ROpJumpNotTruthy, cond, 0);
+            compileStatement(while_expr->body);
+            emit(ROpJump, loopStartPc);
+            patchJump(exitJumpPc, currentPc());
+            auto reg = target(dest);
+            emit(ROpLoadNull, reg);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<ForExpression>(expr)) {
+            auto for_expr = std::dynamic_pointer_cast<ForExpression>(expr);
+            compileStatement(for_expr->init);
+            auto loopStartPc = currentPc();
+            auto mark = registerMark();
+            auto cond = compileExpression(for_expr->condition, -1);
+            freeRegisters(mark);
+            auto exitJumpPc = emit(ROpJumpNotTruthy, cond, 0);
+            compileStatement(for_expr->body);
+            compileStatement(for_expr->update);
+            emit(ROpJump, loopStartPc);
+            patchJump(exitJumpPc, currentPc());
+            auto reg = target(dest);
+            emit(ROpLoadNull, reg);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<ArrayLiteral>(expr)) {
+            auto array = std::dynamic_pointer_cast<ArrayLiteral>(expr);
+            auto mark = registerMark();
+            int first = registerMark();
+            for (auto& elem : array->elements) {
+                compileExpression(elem, allocRegister());
+            }
+            freeRegisters(mark);
+            auto reg = target(dest);
+            emit(ROpArray, reg, first, array->elements.size());
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<HashLiteral>(expr)) {
+            auto hash = std::dynamic_pointer_cast<HashLiteral>(expr);
+            auto mark = registerMark();
+            int first = registerMark();
+            for (auto& pair : hash->pairs) {
+                auto keyReg = allocRegister();
+                auto valueReg = allocRegister();
+                compileExpression(pair.first, keyReg);
+                compileExpression(pair.second, valueReg);
+            }
+            freeRegisters(mark);
+            auto reg = target(dest);
+            emit(ROpHash, reg, first, hash->pairs.size());
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<IndexExpression>(expr)) {
+            auto index_expr = std::dynamic_pointer_cast<IndexExpression>(expr);
+            auto mark = registerMark();
+            auto left = compileExpression(index_expr->left, assignedLater(index_expr->left, index_expr->index) ? allocRegister() : -1);
+            auto index = compileExpression(index_expr->index, -1);
+            freeRegisters(mark);
+            auto reg = target(dest);
+            emit(ROpIndex, reg, left, index);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<FunctionLiteral>(expr)) {
+            auto reg = target(dest);
+            compileFunction(std::dynamic_pointer_cast<FunctionLiteral>(expr), reg);
+            return reg;
+        }
+        if (std::dynamic_pointer_cast<CallExpression>(expr)) {
+            auto reg = dest;
+            compileCall(std::dynamic_pointer_cast<CallExpression>(expr), dest, false);
+            if (reg < 0) {
+                // 结果留在被调函数所在的寄存器, 即调用前的第一个空闲寄存器
+                reg = allocRegister();
+            }
+            return reg;
+        }
+        throw CompileError{"unknown node type " + expr->String()};
+    }
+
+    void RegisterCompiler::compileCall(std::shared_ptr<CallExpression> call, int dest, bool tail) {
+        auto mark = registerMark();
+        // 被调函数与实参放在连续的寄存器中, 被调函数的寄存器窗口从第一个实参开始
+        auto callee = allocRegister();
+        compileExpression(call->function, callee);
+        for (auto& arg : call->arguments) {
+            compileExpression(arg, allocRegister());
+        }
+        freeRegisters(mark);
+        auto numArgs = static_cast<int>(call->arguments.size());
+        if (tail) {
+            emit(ROpTailCall, 0, callee, numArgs);
+        } else {
+            emit(ROpCall, dest >= 0 ? dest : callee, callee, numArgs);
+        }
+    }
+
+    void RegisterCompiler::compileFunction(std::shared_ptr<FunctionLiteral> func, int dest) {
+        auto numLocals = static_cast<int>(func->parameters.size()) + CountLocalDefinitions(func->body);
+        enterScope(numLocals);
+        if (func->name != "") {
+            symbolTable->DefineFunctionName(func->name);
+        }
+        for (auto& param : func->parameters) {
+            symbolTable->Define(param->value);
+        }
+        compileReturnBlock(func->body);
+        auto freeSymbols = symbolTable->GetFreeSymbols();
+        auto numParams = func->parameters.size();
+        auto scope = leaveScope();
+
+        auto compiledFn = std::make_shared<CompiledFunction>(scope.instructions, scope.maxRegisters, numParams);
+        compiledFn->numFree = freeSymbols.size();
+        if (freeSymbols.empty()) {
+            // 没有自由变量的函数在编译期构造好闭包, 运行时只需加载常量
+            emit(ROpLoadConstant, dest, addConstant(std::make_shared<Closure>(compiledFn)));
+            return;
+        }
+        auto fnIndex = addConstant(compiledFn);
+        // 自由变量放在从 first 开始的连续寄存器中, 闭包写回 first
+        auto mark = registerMark();
+        int first = registerMark();
+        for (auto& free : freeSymbols) {
+            loadSymbol(free, allocRegister());
+        }
+        freeRegisters(mark);
+        emit(ROpClosure, first, fnIndex, freeSymbols.size());
+        if (dest != first) {
+            emit(ROpMove, dest, first);
+        }
+    }
+
+    void RegisterCompiler::loadSymbol(const Symbol& symbol, int dest) {
+        auto scope = symbol.scope;
+        if (scope == GlobalScope) {
+            emit(ROpGetGlobal, dest, symbol.index);
+        } else if (scope == LocalScope) {
+            if (dest != symbol.index) {
+                emit(ROpMove, dest, symbol.index);
+            }
+        } else if (scope == BuiltinScope) {
+            emit(ROpGetBuiltin, dest, symbol.index);
+        } else if (scope == FreeScope) {
+            emit(ROpGetFree, dest, symbol.index);
+        } else if (scope == FunctionScope) {
+            emit(ROpCurrentClosure, dest);
+        }
+    }
+
+    void RegisterCompiler::storeSymbol(const Symbol& symbol, int source) {
+        if (symbol.scope == GlobalScope) {
+            emit(ROpSetGlobal, source, symbol.index);
+        } else if (symbol.scope == LocalScope) {
+            if (source != symbol.index) {
+                emit(ROpMove, symbol.index, source);
+            }
+        } else {
+            throw CompileError{"cannot assign to " + symbol.scope + " variable " + symbol.name};
+        }
+    }
+} // namespace monkey
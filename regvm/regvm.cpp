@@ -0,0 +1,391 @@
+#include "../include/regvm.h"
+#include "../include/parallel.h"
+
+// RK 操作数: 常量或当前帧的寄存器
+#define RK(operand) (((operand) & RegConstantBit) ? (*constants)[(operand) & ~RegConstantBit] : R[(operand)])
+
+namespace monkey {
+    void RegisterVM::Run() {
+        if (runtimeStats.enabled) {
+            runtimeStats.peakFrameDepth = std::max(runtimeStats.peakFrameDepth, static_cast<int>(frames.size()));
+            runtimeStats.peakStackDepth = std::max(runtimeStats.peakStackDepth, static_cast<int>(registers.size()));
+        }
+        result = execute(1);
+    }
+
+    std::shared_ptr<Object> RegisterVM::Call(const std::shared_ptr<Object>& fn, ArgsView args) {
+        if (auto builtin = dynamic_cast<Builtin*>(fn.get())) {
+            auto value = builtin->call(ArgsView(args.begin(), args.size(), this));
+            return value ? value : null;
+        }
+        auto cl = std::dynamic_pointer_cast<Closure>(fn);
+        if (cl == nullptr) {
+            throw RunningError{"calling non-function or non-builtin"};
+        }
+        int numArgs = args.size();
+        if (numArgs != cl->fn->numParameters) {
+            throw RunningError{"wrong number of arguments, want=" + std::to_string(cl->fn->numParameters) + ", got=" + std::to_string(numArgs)};
+        }
+        if (static_cast<int>(frames.size()) >= MaxFrames) {
+            throw RunningError{"frames overflow"};
+        }
+        // 被调函数使用单独的寄存器文件: 扩容时外层的寄存器不会移动, 正在执行的内置函数的实参保持有效
+        std::vector<std::shared_ptr<Object>> outer;
+        outer.swap(registers);
+        if (!spareRegisters.empty()) {
+            registers.swap(spareRegisters.back());
+            spareRegisters.pop_back();
+        }
+        ensureRegisters(std::max(cl->fn->numLocals, 1));
+        for (int i = 0; i < numArgs; ++i) {
+            registers[i] = args[i];
+        }
+        frames.emplace_back(cl, 0, 0);
+        auto value = execute(frames.size());
+        frames.pop_back();
+        // 保留寄存器文件供下一次回调使用, 里面的对象先释放
+        std::fill(registers.begin(), registers.end(), nullptr);
+        spareRegisters.emplace_back();
+        spareRegisters.back().swap(registers);
+        registers.swap(outer);
+        return value;
+    }
+
+    std::unique_ptr<Caller> RegisterVM::NewWorker() {
+        return std::unique_ptr<Caller>(new RegisterVM(AnchorSharedObjects(constants, registry), globals));
+    }
+
+    // 寄存器字节码中的全局变量读写, 内置函数和闭包常量
+    static void decodeRegisterEffects(CompiledFunction& fn, FunctionEffects& effects) {
+        const byte* code = fn.instructions.data();
+        int count = fn.instructions.size() / RegInstructionSize;
+        for (int pc = 0; pc < count; ++pc) {
+            auto ins = ReadRegInstruction(code, pc);
+            switch (ins.op) {
+                case ROpSetGlobal:
+                    effects.setsGlobal = true;
+                    break;
+                case ROpGetGlobal:
+                    effects.globals.push_back(ins.b);
+                    break;
+                case ROpGetBuiltin:
+                    effects.builtins.push_back(ins.b);
+                    break;
+                case ROpClosure:
+                    effects.functions.push_back(ins.b);
+                    break;
+            }
+        }
+    }
+
+    bool RegisterVM::ParallelSafe(ArgsView values) {
+        return IsParallelSafe(values, decodeRegisterEffects, *constants, *globals, builtinFns);
+    }
+
+    std::shared_ptr<Object> RegisterVM::execute(size_t exitDepth) {
+        auto frame = &frames.back();
+        const byte* code = frame->cl->fn->instructions.data();
+        auto R = &registers[frame->base];
+        while (true) {
+            auto ins = ReadRegInstruction(code, frame->pc++);
+            if (runtimeStats.enabled) {
+                ++runtimeStats.instructionsExecuted;
+            }
+            switch (ins.op) {
+                case ROpMove:
+                    R[ins.a] = R[ins.b];
+                    break;
+                case ROpLoadConstant:
+                    R[ins.a] = (*constants)[ins.b];
+                    break;
+                case ROpLoadTrue:
+                    R[ins.a] = True;
+                    break;
+                case ROpLoadFalse:
+                    R[ins.a] = False;
+                    break;
+                case ROpLoadNull:
+                    R[ins.a] = null;
+                    break;
+                case ROpGetGlobal:
+                    R[ins.a] = (*globals)[ins.b];
+                    break;
+                case ROpSetGlobal:
+                    (*globals)[ins.b] = R[ins.a];
+                    break;
+                case ROpGetBuiltin:
+                    R[ins.a] = builtinFns[ins.b];
+                    break;
+                case ROpGetFree:
+                    R[ins.a] = frame->cl->free[ins.b];
+                    break;
+                case ROpCurrentClosure:
+                    R[ins.a] = frame->cl;
+                    break;
+                case ROpAdd:
+                case ROpSub:
+                case ROpMul:
+                case ROpDiv:
+                    R[ins.a] = executeBinaryOperation(ins.op, RK(ins.b), RK(ins.c));
+                    break;
+                case ROpEqual:
+                case ROpNotEqual:
+                case ROpGreaterThan:
+                    R[ins.a] = executeComparison(ins.op, RK(ins.b), RK(ins.c));
+                    break;
+                case ROpMinus: {
+                    auto integer = dynamic_cast<Integer*>(R[ins.b].get());
+                    if (integer == nullptr) {
+                        throw RunningError{"unsupported type for negation"};
+                    }
+                    R[ins.a] = std::make_shared<Integer>(0 - integer->value);
+                    break;
+                }
+                case ROpBang:
+                    R[ins.a] = isTruthy(R[ins.b]) ? False : True;
+                    break;
+                case ROpJump:
+                    frame->pc = ins.a;
+                    break;
+                case ROpJumpNotTruthy:
+                    if (!isTruthy(R[ins.a])) {
+                        frame->pc = ins.b;
+                    }
+                    break;
+                case ROpArray:
+                    R[ins.a] = buildArray(frame->base + ins.b, ins.c);
+                    break;
+                case ROpHash:
+                    R[ins.a] = buildHash(frame->base + ins.b, ins.c);
+                    break;
+                case ROpIndex:
+                    R[ins.a] = executeIndexExpression(R[ins.b], R[ins.c]);
+                    break;
+                case ROpCall:
+                case ROpTailCall: {
+                    auto callee = R[ins.b];
+                    int numArgs = ins.c;
+                    if (auto builtin = std::dynamic_pointer_cast<Builtin>(callee)) {
+                        auto value = callBuiltin(builtin.get(), frame->base + ins.b + 1, numArgs);
+                        if (ins.op == ROpCall) {
+                            R[ins.a] = value;
+                            break;
+                        }
+                        // 尾调用内置函数: 结果直接作为当前函数的返回值
+                        if (frames.size() == exitDepth) {
+                            return value;
+                        }
+                        auto retReg = frame->retReg;
+                        frames.pop_back();
+                        registers[retReg] = value;
+                        frame = &frames.back();
+                        code = frame->cl->fn->instructions.data();
+                        R = &registers[frame->base];
+                        break;
+                    }
+                    auto cl = std::dynamic_pointer_cast<Closure>(callee);
+                    if (cl == nullptr) {
+                        throw RunningError{"calling non-function or non-builtin"};
+                    }
+                    auto& fn = cl->fn;
+                    if (numArgs != fn->numParameters) {
+                        throw RunningError{"wrong number of arguments, want=" + std::to_string(fn->numParameters) + ", got=" + std::to_string(numArgs)};
+                    }
+                    if (ins.op == ROpTailCall) {
+                        // 实参移到当前帧的寄存器 0.., 复用当前帧
+                        for (int i = 0; i < numArgs; ++i) {
+                            R[i] = std::move(R[ins.b + 1 + i]);
+                        }
+                        frame->cl = cl;
+                        frame->pc = 0;
+                    } else {
+                        if (static_cast<int>(frames.size()) >= MaxFrames) {
+                            throw RunningError{"frames overflow"};
+                        }
+                        frames.emplace_back(cl, frame->base + ins.b + 1, frame->base + ins.a);
+                        frame = &frames.back();
+                    }
+                    ensureRegisters(frame->base + fn->numLocals);
+                    code = fn->instructions.data();
+                    R = &registers[frame->base];
+                    if (runtimeStats.enabled) {
+                        runtimeStats.peakFrameDepth = std::max(runtimeStats.peakFrameDepth, static_cast<int>(frames.size()));
+                    }
+                    break;
+                }
+                case ROpReturn:
+                case ROpReturnNull: {
+                    auto value = ins.op == ROpReturn ? R[ins.a] : null;
+                    if (frames.size() == exitDepth) {
+                        return value;
+                    }
+                    auto retReg = frame->retReg;
+                    frames.pop_back();
+                    registers[retReg] = std::move(value);
+                    frame = &frames.back();
+                    code = frame->cl->fn->instructions.data();
+                    R = &registers[frame->base];
+                    break;
+                }
+                case ROpClosure: {
+                    auto fn = std::dynamic_pointer_cast<CompiledFunction>((*constants)[ins.b]);
+                    if (fn == nullptr) {
+                        throw RunningError{"not a function: " + (*constants)[ins.b]->type()};
+                    }
+                    std::vector<std::shared_ptr<Object>> free(R + ins.a, R + ins.a + ins.c);
+                    R[ins.a] = std::make_shared<Closure>(fn, free);
+                    break;
+                }
+                default:
+                    throw RunningError{"unknown opcode"};
+            }
+        }
+    }
+#undef RK
+
+    std::shared_ptr<Object> RegisterVM::executeBinaryOperation(Opcode op, const std::shared_ptr<Object>& left, const std::shared_ptr<Object>& right) {
+        auto left_int = dynamic_cast<Integer*>(left.get());
+        auto right_int = dynamic_cast<Integer*>(right.get());
+        if (left_int != nullptr && right_int != nullptr) {
+            auto left_val = left_int->value;
+            auto right_val = right_int->value;
+            switch (op) {
+                case ROpAdd:
+                    return std::make_shared<Integer>(left_val + right_val);
+                case ROpSub:
+                    return std::make_shared<Integer>(left_val - right_val);
+                case ROpMul:
+                    return std::make_shared<Integer>(left_val * right_val);
+                case ROpDiv:
+                    return std::make_shared<Integer>(left_val / right_val);
+                default:
+                    throw RunningError{"unknown integer operation"};
+            }
+        }
+        auto left_str = dynamic_cast<Strin*>(left.get());
+        auto right_str = dynamic_cast<Strin*>(right.get());
+        if (left_str != nullptr && right_str != nullptr) {
+            if (op != ROpAdd) {
+                throw RunningError{"unknown string operation"};
+            }
+            return std::make_shared<Strin>(left_str->value + right_str->value);
+        }
+        throw RunningError{"unsupported types for binary operation " + left->type() + " and " + right->type()};
+    }
+
+    std::shared_ptr<Object> RegisterVM::executeComparison(Opcode op, const std::shared_ptr<Object>& left, const std::shared_ptr<Object>& right) {
+        auto left_int = dynamic_cast<Integer*>(left.get());
+        auto right_int = dynamic_cast<Integer*>(right.get());
+        if (left_int != nullptr && right_int != nullptr) {
+            switch (op) {
+                case ROpEqual:
+                    return left_int->value == right_int->value ? True : False;
+                case ROpNotEqual:
+                    return left_int->value != right_int->value ? True : False;
+                case ROpGreaterThan:
+                    return left_int->value > right_int->value ? True : False;
+                default:
+                    throw RunningError{"unknown integer comparison operation"};
+            }
+        }
+        auto left_str = dynamic_cast<Strin*>(left.get());
+        auto right_str = dynamic_cast<Strin*>(right.get());
+        if (left_str != nullptr && right_str != nullptr) {
+            if (op == ROpEqual) {
+                return left_str->value == right_str->value ? True : False;
+            }
+            if (op == ROpNotEqual) {
+                return left_str->value != right_str->value ? True : False;
+            }
+            throw RunningError{"unknown string comparison operation"};
+        }
+        // 布尔值按值比较, 不依赖 True/False 是否为同一个对象
+        bool equal = left == right;
+        auto left_bool = dynamic_cast<Boolea*>(left.get());
+        auto right_bool = dynamic_cast<Boolea*>(right.get());
+        if (left_bool != nullptr && right_bool != nullptr) {
+            equal = left_bool->value == right_bool->value;
+        }
+        switch (op) {
+            case ROpEqual:
+                return equal ? True : False;
+            case ROpNotEqual:
+                return equal ? False : True;
+            default:
+                throw RunningError{"unsupported types for binary operation " + left->type() + " and " + right->type()};
+        }
+    }
+
+    std::shared_ptr<Object> RegisterVM::executeIndexExpression(const std::shared_ptr<Object>& left, const std::shared_ptr<Object>& index) {
+        auto array = dynamic_cast<Array*>(left.get());
+        auto integer = dynamic_cast<Integer*>(index.get());
+        if (array != nullptr && integer != nullptr) {
+            auto idx = integer->value;
+            if (idx < 0 || idx >= static_cast<int64_t>(array->size())) {
+                return null;
+            }
+            return array->at(idx);
+        }
+        auto hash = dynamic_cast<HashTable*>(left.get());
+        if (hash != nullptr) {
+            auto key = dynamic_cast<Hashable*>(index.get());
+            if (key == nullptr) {
+                throw RunningError{"unusable as hash key: " + index->type()};
+            }
+            auto hashKey = key->hashKey();
+            if (hash->find(hashKey)) {
+                return hash->get(hashKey)->value;
+            }
+            return null;
+        }
+        throw RunningError{"index operator not supported: " + left->type()};
+    }
+
+    std::shared_ptr<Object> RegisterVM::callBuiltin(Builtin* fn, int first, int numArgs) {
+        if (runtimeStats.enabled) {
+            ++runtimeStats.builtinCalls[fn->name];
+        }
+        auto value = fn->call(ArgsView(registers.data() + first, numArgs, this));
+        if (value) {
+            return value;
+        }
+        return null;
+    }
+
+    std::shared_ptr<Array> RegisterVM::buildArray(int first, int count) {
+        std::vector<std::shared_ptr<Object>> elements(registers.begin() + first, registers.begin() + first + count);
+        return std::make_shared<Array>(elements);
+    }
+
+    std::shared_ptr<HashTable> RegisterVM::buildHash(int first, int count) {
+        std::map<std::shared_ptr<HashKey>, std::shared_ptr<HashPair>> pairs;
+        for (int i = first; i < first + count * 2; i += 2) {
+            auto key = registers[i];
+            auto hashable = dynamic_cast<Hashable*>(key.get());
+            if (hashable == nullptr) {
+                throw RunningError{"unusable as hash key: " + key->type()};
+            }
+            pairs[hashable->hashKey()] = std::make_shared<HashPair>(key, registers[i+1]);
+        }
+        return std::make_shared<HashTable>(pairs);
+    }
+
+    void RegisterVM::ensureRegisters(int size) {
+        if (size > static_cast<int>(registers.size())) {
+            registers.resize(std::max(size, static_cast<int>(registers.size()) * 2));
+            if (runtimeStats.enabled) {
+                runtimeStats.peakStackDepth = std::max(runtimeStats.peakStackDepth, static_cast<int>(registers.size()));
+            }
+        }
+    }
+
+    bool RegisterVM::isTruthy(const std::shared_ptr<Object>& obj) {
+        if (auto b = dynamic_cast<Boolea*>(obj.get())) {
+            return b->value;
+        }
+        if (dynamic_cast<Null*>(obj.get())) {
+            return false;
+        }
+        return true;
+    }
+} // namespace monkey
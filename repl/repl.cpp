@@ -19,13 +19,13 @@ namespace monkey{
     /**
      * @return true if error
     */
-    bool start_run(std::ifstream& input, std::ostream& output) {
+    bool start_run(std::ifstream& input, std::ostream& output, const RunOptions& options) {
         std::string line;
         std::string program;
         SymbolTable symbolTable;    // global symbol table
         std::shared_ptr<SymbolTable> symbolTablePtr = std::make_shared<SymbolTable>(symbolTable);
-        registeBuiltinFunctions(symbolTablePtr);
-        Compiler compiler(symbolTablePtr);
+        auto builtins = options.builtins != nullptr ? options.builtins : BuiltinRegistry::Default();
+        registeBuiltinFunctions(symbolTablePtr, *builtins);
 
         while (getline(input, line)) {
             if (line[0] == '#') {
@@ -35,34 +35,70 @@ namespace monkey{
             program += "\n";
         }
         
+        if (runtimeStats.enabled) {
+            recordLexStats(program);
+        }
+
+        Timer timer;
         std::shared_ptr<Lexer> lexer = std::make_shared<Lexer>(program);
         std::shared_ptr<Parser> parser = std::make_shared<Parser>(lexer);
         
         auto program_ast = parser->parseProgram();
+        runtimeStats.parseTime = timer.elapsed();
         if (parser->getErrors().size() != 0) {
             printParserErrors(output, parser->getErrors());
             return true;
         }
 
+        timer.reset();
+        std::shared_ptr<ByteCode> bytecode;
+        if (options.optimizeLevel >= OptimizeDeadCode) {
+            EliminateDeadCode(program_ast, builtins.get());
+        }
         try {
-            compiler.Compile(program_ast);
+            if (options.backend == Backend::Register) {
+                RegisterCompiler compiler(symbolTablePtr);
+                compiler.Compile(program_ast);
+                bytecode = compiler.Bytecode();
+            } else {
+                Compiler compiler(symbolTablePtr);
+                compiler.Compile(program_ast);
+                bytecode = compiler.Bytecode();
+                OptimizeBytecode(bytecode, options.optimizeLevel);
+            }
+            bytecode->builtins = builtins;
         } catch (std::exception& e) {
             output << MONKEY_FACE << "\n";
             output << "Woops! We ran into some monkey business here!\n";
             output << "\033[31m" << e.what() << "\033[0m";
             return true;
         }
+        runtimeStats.compileTime = timer.elapsed();
+        if (runtimeStats.enabled) {
+            recordBytecodeStats(bytecode);
+        }
 
         output << WELCOME << "\n" << std::endl;
-        VM vm(compiler.Bytecode());
+        runtimeStats.beginExecute();
         try {
-            vm.Run();
+            if (options.backend == Backend::Register) {
+                RegisterVM vm(bytecode);
+                vm.Run();
+            } else {
+                VM vm(bytecode);
+                vm.Run();
+            }
         } catch (std::exception& e) {
+            runtimeStats.endExecute();
+            StandardOutput().Flush();
             output << MONKEY_FACE << "\n";
             output << "Woops! We ran into some monkey business here!\n";
             output << "\033[31m" << e.what() << "\033[0m";
             return true;
         }
+        runtimeStats.endExecute();
+        // 脚本的输出写在 output 之后的内容前面
+        StandardOutput().Flush();
         // auto lastPopped = vm.LastPoppedStackElem()->inspect();
         // if (lastPopped != "null") {
         //     output << PROMPT << lastPopped << '\n';
@@ -75,11 +111,13 @@ namespace monkey{
         std::shared_ptr<Constants> constantsPtr = std::make_shared<Constants>(constants);
         Globals globals;    // global variables
         std::shared_ptr<Globals> globalsPtr = std::make_shared<Globals>(globals);
-        globalsPtr->reserve(GlobalsSize);
+        globalsPtr->resize(GlobalsSize);
         SymbolTable symbolTable;    // global symbol table
         std::shared_ptr<SymbolTable> symbolTablePtr = std::make_shared<SymbolTable>(symbolTable);
 
         registeBuiltinFunctions(symbolTablePtr);
+        // 交互模式下 print 的每一行立即显示
+        StandardOutput().Configure(OutputSink::DefaultCapacity, OutputSink::LineBuffered);
 
         doPreAction(symbolTablePtr, constantsPtr, globalsPtr);
 
@@ -100,8 +138,10 @@ namespace monkey{
                 std::exit(EXIT_FAILURE);
             }
 
+            EliminateDeadCode(program);
             auto comp = compiler.NewWithState(symbolTablePtr, constantsPtr);
             // check_symbolTable(*symbolTablePtr); // debug
+            auto firstConstant = constantsPtr->size();
             try{
                 comp->Compile(program);
             } catch (std::exception& e) {
@@ -111,15 +151,18 @@ namespace monkey{
                 std::exit(EXIT_FAILURE);
             }
             auto code = comp->Bytecode();
+            // 之前输入的函数已经优化过, 只优化本次新增的常量
+            OptimizeBytecode(code, DefaultOptimizeLevel, firstConstant);
 
             // debug
             // for (auto& ins : code->instructions) {
             //     std::cerr << "Compile op: " << std::to_string(ins) << std::endl;
             // }
 
-            auto machine = vm.NewWithGlobalsStore(code, globalsPtr);
             // check_globals(globals); // debug
+            std::shared_ptr<VM> machine;
             try {
+                machine = vm.NewWithGlobalsStore(code, globalsPtr);
                 machine->Run();
             } catch (std::exception& e) {
                 out << "\n" << MONKEY_FACE << "\n";
@@ -128,10 +171,13 @@ namespace monkey{
                 std::exit(EXIT_FAILURE);
         }
             auto lastPopped = machine->LastPoppedStackElem();
-            if (lastPopped->inspect() == "null") {
+            std::string echo;
+            lastPopped->inspectTo(echo);
+            if (echo == "null") {
                 continue;
             }
-            out << lastPopped->inspect() << "\n";
+            echo += '\n';
+            out.write(echo.data(), echo.size());
         }
     }
 
@@ -173,11 +219,34 @@ namespace monkey{
         }
     }
 
-    void registeBuiltinFunctions(std::shared_ptr<SymbolTable> symbolTablePtr) {
-        for (int i = 0; i < builtins.size(); ++i) {
-            auto builtin = builtins[i];
-            symbolTablePtr->DefineBuiltin(i, builtin.name);
+    void recordLexStats(const std::string& program) {
+        Timer timer;
+        Lexer lexer(program);
+        size_t tokens = 0;
+        while (lexer.nextToken().getType() != TokenType::EOF) {
+            ++tokens;
         }
+        runtimeStats.lexTime = timer.elapsed();
+        runtimeStats.tokens = tokens;
+    }
+
+    void recordBytecodeStats(std::shared_ptr<ByteCode> bytecode) {
+        size_t size = bytecode->instructions.size();
+        for (auto& constant : *bytecode->constants) {
+            auto fn = std::dynamic_pointer_cast<CompiledFunction>(constant);
+            if (std::dynamic_pointer_cast<Closure>(constant)) {
+                fn = std::dynamic_pointer_cast<Closure>(constant)->fn;
+            }
+            if (fn) {
+                size += fn->instructions.size();
+            }
+        }
+        runtimeStats.bytecodeSize = size;
+        runtimeStats.constantsSize = bytecode->constants->size();
+    }
+
+    void registeBuiltinFunctions(std::shared_ptr<SymbolTable> symbolTablePtr, const BuiltinRegistry& registry) {
+        registry.DefineIn(*symbolTablePtr);
     }
 
     std::string getMultiLineInput(std::istream& in) {
@@ -0,0 +1,81 @@
+#include <iomanip>
+
+#include "../include/stats.h"
+
+namespace monkey {
+    const char* ObjectKindNames[OBJECT_KIND_COUNT] = {
+        "INTEGER",
+        "BOOLEAN",
+        "STRING",
+        "NULL",
+        "RETURN_VALUE",
+        "ERROR",
+        "FUNCTION",
+        "COMPILED_FUNCTION",
+        "BUILTIN",
+        "CLOSURE",
+        "ARRAY",
+        "HASH_KEY",
+        "HASH_PAIR",
+        "HASH_TABLE",
+        "ITERATOR",
+    };
+
+    thread_local RuntimeStats runtimeStats;
+
+    void RuntimeStats::reset() {
+        lexTime = parseTime = compileTime = executeTime = 0;
+        executing = false;
+        tokens = bytecodeSize = constantsSize = 0;
+        for (auto& count : allocations) {
+            count = 0;
+        }
+        peakStackDepth = 0;
+        peakFrameDepth = 0;
+        instructionsExecuted = 0;
+        builtinCalls.clear();
+    }
+
+    void RuntimeStats::beginExecute() {
+        executing = true;
+        executeStart = std::chrono::high_resolution_clock::now();
+    }
+
+    void RuntimeStats::endExecute() {
+        executeTime = currentExecuteTime();
+        executing = false;
+    }
+
+    double RuntimeStats::currentExecuteTime() const {
+        if (!executing) {
+            return executeTime;
+        }
+        return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - executeStart).count();
+    }
+
+    void printStats(std::ostream& output) {
+        auto& s = runtimeStats;
+        output << "\033[33m" << "---------------- stats ----------------\n";
+        output << std::fixed << std::setprecision(3);
+        output << "lexing:                 " << s.lexTime * 1000 << " ms (" << s.tokens << " tokens)\n";
+        output << "parsing (incl. lexing): " << s.parseTime * 1000 << " ms\n";
+        output << "compiling:              " << s.compileTime * 1000 << " ms\n";
+        output << "executing:              " << s.currentExecuteTime() * 1000 << " ms\n";
+        output << "bytecode size:          " << s.bytecodeSize << " bytes\n";
+        output << "constant pool size:     " << s.constantsSize << "\n";
+        output << "peak stack depth:       " << s.peakStackDepth << "\n";
+        output << "peak frame depth:       " << s.peakFrameDepth << "\n";
+        output << "instructions executed:  " << s.instructionsExecuted << "\n";
+        output << "allocations:\n";
+        for (int i = 0; i < OBJECT_KIND_COUNT; ++i) {
+            if (s.allocations[i] != 0) {
+                output << "  " << std::left << std::setw(22) << ObjectKindNames[i] << std::right << s.allocations[i] << "\n";
+            }
+        }
+        output << "builtin calls:\n";
+        for (auto& call : s.builtinCalls) {
+            output << "  " << std::left << std::setw(22) << call.first << std::right << call.second << "\n";
+        }
+        output << "---------------------------------------" << "\033[0m" << std::endl;
+    }
+} // namespace monkey
@@ -1,10 +1,60 @@
 #include "../include/token.h"
 
 namespace monkey {
-    TokenType lookupIdent(std::string ident) {
-        if (keywords.find(ident) != keywords.end()) {
-            return keywords[ident];
+    const std::vector<std::string> TokenTypeString = {
+        "ILLEGAL",
+        "EOF",
+        "IDENT",
+        "INT",
+        "STRING",
+        "ASSIGN",
+        "PLUS",
+        "MINUS",
+        "BANG",
+        "ASTERISK",
+        "SLASH",
+        "LT",
+        "GT",
+        "EQ",
+        "NOT_EQ",
+        "COMMA",
+        "SEMICOLON",
+        "COLON",
+        "LPAREN",
+        "RPAREN",
+        "LBRACKET",
+        "RBRACKET",
+        "LBRACE",
+        "RBRACE",
+        "FUNCTION",
+        "LET",
+        "TRUE",
+        "FALSE",
+        "IF",
+        "ELSE",
+        "RETURN",
+        "MACRO",
+        "WHILE",
+        "FOR"
+    };
+
+    const std::map<std::string, TokenType> keywords = {
+        {"fn", TokenType::FUNCTION},
+        {"let", TokenType::LET},
+        {"true", TokenType::TRUE},
+        {"false", TokenType::FALSE},
+        {"if", TokenType::IF},
+        {"else", TokenType::ELSE},
+        {"return", TokenType::RETURN},
+        {"while", TokenType::WHILE},
+        {"for", TokenType::FOR}
+    };
+
+    TokenType lookupIdent(const std::string& ident) {
+        auto it = keywords.find(ident);
+        if (it != keywords.end()) {
+            return it->second;
         }
         return TokenType::IDENT;
     }
-}
\ No newline at end of file
+} // namespace monkey
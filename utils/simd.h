@@ -0,0 +1,303 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 紧凑整数数组 (Array::ints) 的求和, 最值和点积, 以及字符串内置函数用到的字节扫描.
+// 加法和乘法按补码回绕, 与 VM 的整数运算结果一致.
+// 默认只用 SSE2 (x86-64 的基线): 求和与字节扫描是向量化的, 最值和点积是标量循环.
+// 用 -DMONKEY_NATIVE_ARCH=ON 构建时按本机指令集启用 SSE4.2 (最值) 和 AVX2 (全部)
+namespace monkey {
+    inline int64_t SumInt64(const int64_t* data, size_t n) {
+        size_t i = 0;
+        uint64_t total = 0;
+#if defined(__AVX2__)
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 4 <= n; i += 4) {
+            acc = _mm256_add_epi64(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i)));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__SSE2__)
+        __m128i acc = _mm_setzero_si128();
+        for (; i + 2 <= n; i += 2) {
+            acc = _mm_add_epi64(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+        }
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+        total = lanes[0] + lanes[1];
+#endif
+        for (; i < n; ++i) {
+            total += static_cast<uint64_t>(data[i]);
+        }
+        return static_cast<int64_t>(total);
+    }
+
+    // 没有 64 位的 min/max 指令: 比较后按掩码选择. 用两组累加器, 减少相邻迭代之间的依赖.
+    // 64 位比较 (pcmpgtq) 从 SSE4.2 才有, 只有 SSE2 时用标量循环: 拼出来的 32 位比较并不比它快
+    template <bool Less>
+    inline int64_t minMaxInt64(const int64_t* data, size_t n) {
+        size_t i = 0;
+        int64_t best = data[0];
+#if defined(__AVX2__)
+        if (n >= 8) {
+            __m256i acc0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            __m256i acc1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 4));
+            for (i = 8; i + 8 <= n; i += 8) {
+                __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + 4));
+                if (Less) {
+                    acc0 = _mm256_blendv_epi8(acc0, v0, _mm256_cmpgt_epi64(acc0, v0));
+                    acc1 = _mm256_blendv_epi8(acc1, v1, _mm256_cmpgt_epi64(acc1, v1));
+                } else {
+                    acc0 = _mm256_blendv_epi8(acc0, v0, _mm256_cmpgt_epi64(v0, acc0));
+                    acc1 = _mm256_blendv_epi8(acc1, v1, _mm256_cmpgt_epi64(v1, acc1));
+                }
+            }
+            int64_t lanes[8];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 4), acc1);
+            for (auto lane : lanes) {
+                best = (Less ? lane < best : lane > best) ? lane : best;
+            }
+        }
+#elif defined(__SSE4_2__)
+        if (n >= 4) {
+            __m128i acc0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+            __m128i acc1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 2));
+            for (i = 4; i + 4 <= n; i += 4) {
+                __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+                if (Less) {
+                    acc0 = _mm_blendv_epi8(acc0, v0, _mm_cmpgt_epi64(acc0, v0));
+                    acc1 = _mm_blendv_epi8(acc1, v1, _mm_cmpgt_epi64(acc1, v1));
+                } else {
+                    acc0 = _mm_blendv_epi8(acc0, v0, _mm_cmpgt_epi64(v0, acc0));
+                    acc1 = _mm_blendv_epi8(acc1, v1, _mm_cmpgt_epi64(v1, acc1));
+                }
+            }
+            int64_t lanes[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc0);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 2), acc1);
+            for (auto lane : lanes) {
+                best = (Less ? lane < best : lane > best) ? lane : best;
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            best = (Less ? data[i] < best : data[i] > best) ? data[i] : best;
+        }
+        return best;
+    }
+
+    // n 必须大于 0
+    inline int64_t MinInt64(const int64_t* data, size_t n) {
+        return minMaxInt64<true>(data, n);
+    }
+
+    inline int64_t MaxInt64(const int64_t* data, size_t n) {
+        return minMaxInt64<false>(data, n);
+    }
+
+    inline int64_t DotInt64(const int64_t* a, const int64_t* b, size_t n) {
+        size_t i = 0;
+        uint64_t total = 0;
+#if defined(__AVX2__)
+        // AVX2 只有 32x32->64 位乘法: 低 64 位 = lo*lo + ((hi_a*lo_b + lo_a*hi_b) << 32).
+        // 每次只有两个时 (SSE2) 这样拼乘法不比标量的 imul 快, 所以没有 SSE2 版本
+        __m256i acc = _mm256_setzero_si256();
+        for (; i + 4 <= n; i += 4) {
+            __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            __m256i low = _mm256_mul_epu32(x, y);
+            __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y),
+                                             _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+            acc = _mm256_add_epi64(acc, _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32)));
+        }
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+        for (; i < n; ++i) {
+            total += static_cast<uint64_t>(a[i]) * static_cast<uint64_t>(b[i]);
+        }
+        return static_cast<int64_t>(total);
+    }
+
+    // 空白字符: 空格和 \t \n \v \f \r
+    inline bool IsSpaceByte(char c) {
+        return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+    }
+
+    // 按块扫描字节: AVX2 下一块 32 字节, SSE2 下 16 字节. 比较结果压成位掩码, 第 i 位对应块中第 i 个字节
+#if defined(__AVX2__)
+    typedef __m256i ByteBlock;
+    const size_t ByteBlockSize = 32;
+
+    inline ByteBlock loadBytes(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    inline void storeBytes(char* p, ByteBlock v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    inline ByteBlock splatByte(char c) { return _mm256_set1_epi8(c); }
+    inline ByteBlock equalBytes(ByteBlock a, ByteBlock b) { return _mm256_cmpeq_epi8(a, b); }
+    inline ByteBlock andBytes(ByteBlock a, ByteBlock b) { return _mm256_and_si256(a, b); }
+    inline ByteBlock orBytes(ByteBlock a, ByteBlock b) { return _mm256_or_si256(a, b); }
+    inline ByteBlock xorBytes(ByteBlock a, ByteBlock b) { return _mm256_xor_si256(a, b); }
+    inline ByteBlock subBytes(ByteBlock a, ByteBlock b) { return _mm256_sub_epi8(a, b); }
+    inline ByteBlock minBytes(ByteBlock a, ByteBlock b) { return _mm256_min_epu8(a, b); }
+    inline uint32_t maskBytes(ByteBlock v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+#define MONKEY_SIMD_BYTES 1
+#elif defined(__SSE2__)
+    typedef __m128i ByteBlock;
+    const size_t ByteBlockSize = 16;
+
+    inline ByteBlock loadBytes(const char* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    inline void storeBytes(char* p, ByteBlock v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    inline ByteBlock splatByte(char c) { return _mm_set1_epi8(c); }
+    inline ByteBlock equalBytes(ByteBlock a, ByteBlock b) { return _mm_cmpeq_epi8(a, b); }
+    inline ByteBlock andBytes(ByteBlock a, ByteBlock b) { return _mm_and_si128(a, b); }
+    inline ByteBlock orBytes(ByteBlock a, ByteBlock b) { return _mm_or_si128(a, b); }
+    inline ByteBlock xorBytes(ByteBlock a, ByteBlock b) { return _mm_xor_si128(a, b); }
+    inline ByteBlock subBytes(ByteBlock a, ByteBlock b) { return _mm_sub_epi8(a, b); }
+    inline ByteBlock minBytes(ByteBlock a, ByteBlock b) { return _mm_min_epu8(a, b); }
+    inline uint32_t maskBytes(ByteBlock v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+#define MONKEY_SIMD_BYTES 1
+#endif
+
+#if defined(MONKEY_SIMD_BYTES)
+    // 无符号比较 lo <= v - base <= lo + span 的通用写法: min(d, span) == d
+    inline ByteBlock inRangeBytes(ByteBlock v, char base, char span) {
+        ByteBlock d = subBytes(v, splatByte(base));
+        return equalBytes(minBytes(d, splatByte(span)), d);
+    }
+
+    inline ByteBlock spaceBytes(ByteBlock v) {
+        return orBytes(equalBytes(v, splatByte(' ')), inRangeBytes(v, '\t', '\r' - '\t'));
+    }
+#endif
+
+    // 第一个等于 c 的字节的位置, 没有时返回 n
+    inline size_t FindByte(const char* s, size_t n, char c) {
+        size_t i = 0;
+#if defined(MONKEY_SIMD_BYTES)
+        ByteBlock target = splatByte(c);
+        for (; i + ByteBlockSize <= n; i += ByteBlockSize) {
+            uint32_t mask = maskBytes(equalBytes(loadBytes(s + i), target));
+            if (mask != 0) {
+                return i + __builtin_ctz(mask);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            if (s[i] == c) {
+                return i;
+            }
+        }
+        return n;
+    }
+
+    // 子串 needle (长度 m > 0) 第一次出现的位置, 没有时返回 n.
+    // 每块同时比较 needle 的首字节和末字节, 两者都相等的位置才逐字节确认, 大多数位置不用调用 memcmp
+    inline size_t FindString(const char* s, size_t n, const char* needle, size_t m) {
+        if (m > n) {
+            return n;
+        }
+        if (m == 1) {
+            return FindByte(s, n, needle[0]);
+        }
+        size_t i = 0;
+#if defined(MONKEY_SIMD_BYTES)
+        ByteBlock head = splatByte(needle[0]);
+        ByteBlock tail = splatByte(needle[m - 1]);
+        for (; i + m - 1 + ByteBlockSize <= n; i += ByteBlockSize) {
+            uint32_t mask = maskBytes(andBytes(equalBytes(loadBytes(s + i), head),
+                                               equalBytes(loadBytes(s + i + m - 1), tail)));
+            while (mask != 0) {
+                size_t at = i + __builtin_ctz(mask);
+                if (memcmp(s + at + 1, needle + 1, m - 2) == 0) {
+                    return at;
+                }
+                mask &= mask - 1;
+            }
+        }
+#endif
+        for (; i + m <= n; ++i) {
+            if (s[i] == needle[0] && memcmp(s + i + 1, needle + 1, m - 1) == 0) {
+                return i;
+            }
+        }
+        return n;
+    }
+
+    // 第一个空白字符的位置, 没有时返回 n
+    inline size_t FindSpace(const char* s, size_t n) {
+        size_t i = 0;
+#if defined(MONKEY_SIMD_BYTES)
+        for (; i + ByteBlockSize <= n; i += ByteBlockSize) {
+            uint32_t mask = maskBytes(spaceBytes(loadBytes(s + i)));
+            if (mask != 0) {
+                return i + __builtin_ctz(mask);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            if (IsSpaceByte(s[i])) {
+                return i;
+            }
+        }
+        return n;
+    }
+
+    // 第一个非空白字符的位置, 没有时返回 n
+    inline size_t SkipSpace(const char* s, size_t n) {
+        size_t i = 0;
+#if defined(MONKEY_SIMD_BYTES)
+        const uint32_t all = static_cast<uint32_t>((uint64_t(1) << ByteBlockSize) - 1);
+        for (; i + ByteBlockSize <= n; i += ByteBlockSize) {
+            uint32_t mask = maskBytes(spaceBytes(loadBytes(s + i))) ^ all;
+            if (mask != 0) {
+                return i + __builtin_ctz(mask);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            if (!IsSpaceByte(s[i])) {
+                return i;
+            }
+        }
+        return n;
+    }
+
+    // 把 [from, from + 25] 范围内的 ASCII 字母翻转大小写 (异或 0x20), 其他字节不变
+    inline void flipAsciiCase(char* s, size_t n, char from) {
+        size_t i = 0;
+#if defined(MONKEY_SIMD_BYTES)
+        ByteBlock bit = splatByte(0x20);
+        for (; i + ByteBlockSize <= n; i += ByteBlockSize) {
+            ByteBlock v = loadBytes(s + i);
+            storeBytes(s + i, xorBytes(v, andBytes(inRangeBytes(v, from, 25), bit)));
+        }
+#endif
+        for (; i < n; ++i) {
+            if (static_cast<unsigned char>(s[i] - from) <= 25) {
+                s[i] ^= 0x20;
+            }
+        }
+    }
+
+    inline void ToUpperAscii(char* s, size_t n) {
+        flipAsciiCase(s, n, 'a');
+    }
+
+    inline void ToLowerAscii(char* s, size_t n) {
+        flipAsciiCase(s, n, 'A');
+    }
+} // namespace monkey
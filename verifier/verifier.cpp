@@ -0,0 +1,237 @@
+#include "../include/verifier.h"
+#include "../include/vm.h"
+
+namespace monkey {
+    namespace {
+        // 指令执行前栈上至少要有的值的个数
+        int stackInputs(Opcode op, const std::vector<uint16_t>& operands) {
+            switch (op) {
+                case OpPop:
+                case OpMinus:
+                case OpBang:
+                case OpJumpNotTruthy:
+                case OpSetGlobal:
+                case OpSetLocal:
+                case OpReturnValue:
+                    return 1;
+                case OpAdd:
+                case OpSub:
+                case OpMul:
+                case OpDiv:
+                case OpEqual:
+                case OpNotEqual:
+                case OpGreaterThan:
+                case OpIndex:
+                    return 2;
+                case OpArray:
+                    return operands[0];
+                case OpHash:
+                    return 2 * operands[0];
+                case OpCall:
+                case OpTailCall:
+                    return operands[0] + 1;
+                case OpClosure:
+                    return operands[1];
+                default:
+                    return 0;
+            }
+        }
+
+        class Verifier {
+        public:
+            Verifier(Instructions& ins, const Constants& constants, int numGlobals, int numBuiltins, std::string where)
+                : ins(ins), constants(constants), numGlobals(numGlobals), numBuiltins(numBuiltins), where(where) {}
+
+            // 主程序可以执行到末尾, 也可以用 return 提前结束; 函数则必须以返回结束
+            void run(int numLocals, int numFree, int maxStackDepth, bool isMain);
+
+        private:
+            void decode();
+
+            void flowTo(int target, int depth, int from);
+
+            void checkOperands(Opcode op, const std::vector<uint16_t>& operands, int offset);
+
+            void fail(int offset, const std::string& msg) {
+                throw VerifyError{where + " at " + std::to_string(offset) + ": " + msg};
+            }
+
+        private:
+            Instructions& ins;
+            const Constants& constants;
+            int numGlobals;
+            int numBuiltins;
+            std::string where;
+            int numLocals = 0;
+            int numFree = 0;
+            bool isMain = false;
+            std::vector<bool> boundary;     // 每个偏移是否是一条指令的开头, 末尾也算
+            std::vector<int> depthAt;       // 每条指令入口处的栈深度, -1 表示还未到达
+            std::vector<int> worklist;
+        };
+
+        void Verifier::run(int numLocals, int numFree, int maxStackDepth, bool isMain) {
+            this->numLocals = numLocals;
+            this->numFree = numFree;
+            this->isMain = isMain;
+            decode();
+            int size = ins.size();
+            depthAt.assign(size + 1, -1);
+            int maxDepth = 0;
+            flowTo(0, 0, 0);
+            while (!worklist.empty()) {
+                int offset = worklist.back();
+                worklist.pop_back();
+                if (offset == size) {
+                    continue;
+                }
+                auto op = ins[offset];
+                auto def = Lookup(op);
+                auto operands = ReadOperands(def, ins, offset + 1);
+                int depth = depthAt[offset];
+                if (depth < stackInputs(op, operands)) {
+                    fail(offset, "stack underflow in " + def->Name);
+                }
+                checkOperands(op, operands, offset);
+                depth += StackEffect(op, operands);
+                maxDepth = std::max(maxDepth, depth);
+                int next = offset + 1;
+                for (auto width : def->OperandWidths) {
+                    next += width;
+                }
+                if (op == OpJump || op == OpJumpNotTruthy) {
+                    flowTo(operands[0], depth, offset);
+                }
+                if (op != OpJump && op != OpReturnValue && op != OpReturn) {
+                    flowTo(next, depth, offset);
+                }
+            }
+            if (maxDepth > maxStackDepth) {
+                throw VerifyError{where + ": stack depth " + std::to_string(maxDepth)
+                        + " exceeds declared max " + std::to_string(maxStackDepth)};
+            }
+        }
+
+        void Verifier::decode() {
+            int size = ins.size();
+            boundary.assign(size + 1, false);
+            for (int offset = 0; offset < size;) {
+                auto def = Lookup(ins[offset]);
+                if (def == nullptr) {
+                    fail(offset, "unknown opcode " + std::to_string(ins[offset]));
+                }
+                boundary[offset] = true;
+                int next = offset + 1;
+                for (auto width : def->OperandWidths) {
+                    next += width;
+                }
+                if (next > size) {
+                    fail(offset, "truncated " + def->Name);
+                }
+                offset = next;
+            }
+            boundary[size] = true;
+        }
+
+        void Verifier::flowTo(int target, int depth, int from) {
+            int size = ins.size();
+            if (target > size || !boundary[target]) {
+                fail(from, "jump target " + std::to_string(target) + " is not an instruction boundary");
+            }
+            if (target == size && !isMain) {
+                fail(from, "control falls off the end of the function");
+            }
+            if (depthAt[target] < 0) {
+                depthAt[target] = depth;
+                worklist.push_back(target);
+            } else if (depthAt[target] != depth) {
+                fail(target, "inconsistent stack depth " + std::to_string(depthAt[target])
+                        + " and " + std::to_string(depth));
+            }
+        }
+
+        void Verifier::checkOperands(Opcode op, const std::vector<uint16_t>& operands, int offset) {
+            switch (op) {
+                case OpConstant:
+                    if (operands[0] >= constants.size()) {
+                        fail(offset, "constant index " + std::to_string(operands[0]) + " out of range");
+                    }
+                    break;
+                case OpClosure: {
+                    if (operands[0] >= constants.size()) {
+                        fail(offset, "constant index " + std::to_string(operands[0]) + " out of range");
+                    }
+                    auto fn = std::dynamic_pointer_cast<CompiledFunction>(constants[operands[0]]);
+                    if (fn == nullptr) {
+                        fail(offset, "not a function: " + constants[operands[0]]->type());
+                    }
+                    if (operands[1] != fn->numFree) {
+                        fail(offset, "closure captures " + std::to_string(operands[1])
+                                + " free variables, function wants " + std::to_string(fn->numFree));
+                    }
+                    break;
+                }
+                case OpGetGlobal:
+                case OpSetGlobal:
+                    if (operands[0] >= numGlobals) {
+                        fail(offset, "global index " + std::to_string(operands[0]) + " out of range");
+                    }
+                    break;
+                case OpGetLocal:
+                case OpSetLocal:
+                    if (operands[0] >= numLocals) {
+                        fail(offset, "local index " + std::to_string(operands[0]) + " out of range");
+                    }
+                    break;
+                case OpGetFree:
+                    if (operands[0] >= numFree) {
+                        fail(offset, "free index " + std::to_string(operands[0]) + " out of range");
+                    }
+                    break;
+                case OpGetBuiltin:
+                    if (operands[0] >= numBuiltins) {
+                        fail(offset, "builtin index " + std::to_string(operands[0]) + " out of range");
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+    } // namespace
+
+    void VerifyBytecode(std::shared_ptr<ByteCode> bytecode) {
+        if (bytecode->verified) {
+            return;
+        }
+        if (bytecode->numGlobals < 0 || bytecode->numGlobals > GlobalsSize) {
+            throw VerifyError{"too many globals: " + std::to_string(bytecode->numGlobals)};
+        }
+        if (bytecode->builtins == nullptr) {
+            throw VerifyError{"missing builtin table"};
+        }
+        int numBuiltins = bytecode->builtins->Size();
+        auto& constants = *bytecode->constants;
+        for (size_t i = 0; i < constants.size(); ++i) {
+            auto fn = std::dynamic_pointer_cast<CompiledFunction>(constants[i]);
+            auto cl = std::dynamic_pointer_cast<Closure>(constants[i]);
+            if (cl != nullptr) {
+                fn = cl->fn;
+                if (static_cast<int>(cl->free.size()) != fn->numFree) {
+                    throw VerifyError{"constant " + std::to_string(i) + ": closure free variable count mismatch"};
+                }
+            }
+            if (fn == nullptr || fn->verified) {
+                continue;
+            }
+            if (fn->numParameters > fn->numLocals) {
+                throw VerifyError{"constant " + std::to_string(i) + ": more parameters than locals"};
+            }
+            Verifier verifier(fn->instructions, constants, bytecode->numGlobals, numBuiltins, "function " + std::to_string(i));
+            verifier.run(fn->numLocals, fn->numFree, fn->maxStackDepth, false);
+            fn->verified = true;
+        }
+        Verifier verifier(bytecode->instructions, constants, bytecode->numGlobals, numBuiltins, "main");
+        verifier.run(0, 0, bytecode->maxStackDepth, true);
+        bytecode->verified = true;
+    }
+} // namespace monkey
@@ -1,12 +1,117 @@
 #include "../include/vm.h"
+#include "../include/parallel.h"
 
 namespace monkey {
+    const std::shared_ptr<Boolea> True = std::make_shared<Boolea>(true);
+    const std::shared_ptr<Boolea> False = std::make_shared<Boolea>(false);
+    const std::shared_ptr<Null> null = std::make_shared<Null>();
+
+    AnchoredObjects AnchorSharedObjects(std::shared_ptr<Constants> shared, std::shared_ptr<const BuiltinRegistry> builtins) {
+        // 锚点只持有共享常量池和内置函数表, 它的控制块由这一个 VM 独占
+        std::shared_ptr<void> anchor = std::make_shared<std::pair<std::shared_ptr<Constants>, std::shared_ptr<const BuiltinRegistry>>>(shared, builtins);
+        AnchoredObjects objects;
+        objects.constants = std::make_shared<Constants>();
+        objects.constants->reserve(shared->size());
+        for (auto& constant : *shared) {
+            objects.constants->emplace_back(anchor, constant.get());
+        }
+        objects.True = std::shared_ptr<Boolea>(anchor, True.get());
+        objects.False = std::shared_ptr<Boolea>(anchor, False.get());
+        objects.null = std::shared_ptr<Null>(anchor, null.get());
+        objects.builtins.reserve(builtins->Size());
+        for (size_t i = 0; i < builtins->Size(); ++i) {
+            objects.builtins.emplace_back(anchor, (*builtins)[i].fn.get());
+        }
+        objects.registry = builtins;
+        return objects;
+    }
+
     void VM::Run() {
-        while (currentFrame()->ip < static_cast<int>(currentFrame()->getInstructions().size() - 1)) {
-            ++currentFrame()->ip;
-            auto& ip = currentFrame()->ip;
-            auto instructions = currentFrame()->getInstructions();
+        if (runtimeStats.enabled && framesIndex > runtimeStats.peakFrameDepth) {
+            runtimeStats.peakFrameDepth = framesIndex;
+        }
+        auto mainFrame = currentFrame();
+        if (sp + mainFrame->cl->fn->numLocals + mainFrame->cl->fn->maxStackDepth > StackSize) {
+            throw RunningError{"stack overflow"};
+        }
+        execute(0);
+    }
+
+    std::shared_ptr<Object> VM::Call(const std::shared_ptr<Object>& fn, ArgsView args) {
+        if (auto builtin = dynamic_cast<Builtin*>(fn.get())) {
+            auto result = builtin->call(ArgsView(args.begin(), args.size(), this));
+            return result ? result : null;
+        }
+        auto cl = std::dynamic_pointer_cast<Closure>(fn);
+        if (cl == nullptr) {
+            throw RunningError{"calling non-function or non-builtin"};
+        }
+        // 被调函数和实参压在调用它的内置函数的实参之上, 栈空间由 callFunction 检查
+        int numArgs = args.size();
+        if (sp + 1 + numArgs > StackSize) {
+            throw RunningError{"stack overflow"};
+        }
+        push(fn);
+        for (auto& arg : args) {
+            push(arg);
+        }
+        int exitFrames = framesIndex;
+        callFunction(cl, numArgs);
+        execute(exitFrames);
+        return pop();
+    }
+
+    std::unique_ptr<Caller> VM::NewWorker() {
+        return std::unique_ptr<Caller>(new VM(AnchorSharedObjects(constants, registry), globals));
+    }
+
+    // 栈式字节码中的全局变量读写, 内置函数和闭包常量
+    static void decodeStackEffects(CompiledFunction& fn, FunctionEffects& effects) {
+        auto& ins = fn.instructions;
+        for (size_t ip = 0; ip < ins.size(); ) {
+            auto def = Lookup(ins[ip]);
+            if (def == nullptr) {
+                throw CodeError{"Unknown opcode in 'decodeStackEffects()'\n"};
+            }
+            auto operands = ReadOperands(def, ins, ip + 1);
+            switch (ins[ip]) {
+                case OpSetGlobal:
+                    effects.setsGlobal = true;
+                    break;
+                case OpGetGlobal:
+                    effects.globals.push_back(operands[0]);
+                    break;
+                case OpGetBuiltin:
+                    effects.builtins.push_back(operands[0]);
+                    break;
+                case OpClosure:
+                    effects.functions.push_back(operands[0]);
+                    break;
+            }
+            ip += 1;
+            for (auto width : def->OperandWidths) {
+                ip += width;
+            }
+        }
+    }
+
+    bool VM::ParallelSafe(ArgsView values) {
+        return IsParallelSafe(values, decodeStackEffects, *constants, *globals, builtinFns);
+    }
+
+    void VM::execute(int exitFrames) {
+        while (true) {
+            // 调用和返回都会切换帧, 每条指令重新取当前帧 (不增加引用计数, 也不复制指令)
+            auto frame = frames[framesIndex-1].get();
+            auto& instructions = frame->getInstructions();
+            if (frame->ip >= static_cast<int>(instructions.size()) - 1) {
+                break;
+            }
+            auto& ip = ++frame->ip;
             auto op = instructions[ip];
+            if (runtimeStats.enabled) {
+                ++runtimeStats.instructionsExecuted;
+            }
             switch (op) {
                 case OpConstant: {
                     auto const_index = ReadUint16(instructions, ip+1);
@@ -94,17 +199,41 @@ namespace monkey {
                     executeCall(num_args);
                     break;
                 }
+                case OpTailCall: {
+                    auto num_args = ReadUint8(instructions, ip+1);
+                    ip += 1;
+                    executeTailCall(num_args);
+                    break;
+                }
                 case OpReturn: {
+                    if (framesIndex == 1) {
+                        // 顶层的 return 结束主程序, 与寄存器 VM 一致
+                        push(null);
+                        pop();
+                        frame->ip = instructions.size();
+                        return;
+                    }
                     auto frame = popFrame();
                     sp = frame->basePointer - 1;
                     push(null);
+                    if (framesIndex == exitFrames) {
+                        return;
+                    }
                     break;
                 }
                 case OpReturnValue: {
                     auto return_value = pop();
+                    if (framesIndex == 1) {
+                        // 返回值留在 LastPoppedStackElem() 的位置
+                        frame->ip = instructions.size();
+                        return;
+                    }
                     auto frame = popFrame();
                     sp = frame->basePointer - 1;
                     push(return_value);
+                    if (framesIndex == exitFrames) {
+                        return;
+                    }
                     break;
                 }
                 case OpSetGlobal: {
@@ -124,7 +253,6 @@ namespace monkey {
                 case OpSetLocal: {
                     auto local_index = ReadUint8(instructions, ip+1);
                     ip += 1;
-                    auto frame = currentFrame();
                     stack[frame->basePointer + local_index] = pop();
                     // std::cout << "Run: OpSetLocal " << stack[frame->basePointer + local_index]->inspect() << std::endl; // debug
                     break;
@@ -132,7 +260,6 @@ namespace monkey {
                 case OpGetLocal: {
                     auto local_index = ReadUint8(instructions, ip+1);
                     ip += 1;
-                    auto frame = currentFrame();
                     push(stack[frame->basePointer + local_index]);
                     // std::cout << "Run: OpGetLocal " << stack[frame->basePointer + local_index]->inspect() << std::endl; // debug
                     break;
@@ -140,20 +267,17 @@ namespace monkey {
                 case OpGetBuiltin: {
                     auto builtin_index = ReadUint8(instructions, ip+1);
                     ip += 1;
-                    auto builtin_def = builtins[builtin_index];
-                    push(builtin_def.fn);
+                    push(builtinFns[builtin_index]);
                     break;
                 }
                 case OpGetFree: {
                     auto free_index = ReadUint8(instructions, ip+1);
                     ip += 1;
-                    auto current_cl = currentFrame()->cl;
-                    push(current_cl->free[free_index]);
+                    push(frame->cl->free[free_index]);
                     break;
                 }
                 case OpCurrentClosure: {
-                    auto current_cl = currentFrame()->cl;
-                    push(current_cl);
+                    push(frame->cl);
                     break;
                 }
                 case OpClosure: {
@@ -284,7 +408,8 @@ namespace monkey {
         } else if (operand == nullptr) {
             throw RunningError{"operand is null"};
         } else {
-            push(False);
+            // 不是全局 True/False 的布尔值 (宿主或扩展新建的) 按值判断, 与寄存器 VM 一致
+            push(isTruthy(operand) ? False : True);
         }
     }
 
@@ -312,10 +437,10 @@ namespace monkey {
     void VM::executeArrayIndex(std::shared_ptr<Object> array, std::shared_ptr<Object> index) {
         auto arr = std::dynamic_pointer_cast<Array>(array);
         auto idx = std::dynamic_pointer_cast<Integer>(index)->value;
-        if (idx < 0 || idx >= arr->elements.size()) {
+        if (idx < 0 || idx >= static_cast<int64_t>(arr->size())) {
             push(null);
         } else {
-            push(arr->elements[idx]);
+            push(arr->at(idx));
         }
     }
 
@@ -361,28 +486,58 @@ namespace monkey {
             return;
         }
         if (type == "BUILTIN") {
-            callBuiltin(std::dynamic_pointer_cast<Builtin>(calledFn), numArgs);
+            callBuiltin(static_cast<Builtin*>(calledFn.get()), numArgs);
             return;
         }
         throw RunningError{"calling non-function or non-builtin"};
     }
 
+    // 尾调用: 被调函数和实参移到当前帧的位置, 复用当前帧而不是压入新帧
+    void VM::executeTailCall(int numArgs) {
+        auto calledFn = stack[sp-1-numArgs];
+        if (framesIndex == 1 || calledFn->type() != "CLOSURE") {
+            // 内置函数的结果由紧随其后的 OpReturnValue 返回
+            executeCall(numArgs);
+            return;
+        }
+        auto cl = std::dynamic_pointer_cast<Closure>(calledFn);
+        auto& fn = cl->fn;
+        if (numArgs != fn->numParameters) {
+            throw RunningError{"wrong number of arguments, want=" + std::to_string(fn->numParameters) + ", got=" + std::to_string(numArgs)};
+        }
+        auto frame = currentFrame();
+        if (frame->basePointer + fn->numLocals + fn->maxStackDepth > StackSize) {
+            throw RunningError{"stack overflow"};
+        }
+        int calleePos = frame->basePointer - 1;
+        for (int i = 0; i <= numArgs; ++i) {
+            stack[calleePos + i] = stack[sp-1-numArgs+i];
+        }
+        frame->cl = cl;
+        frame->ip = -1;
+        sp = frame->basePointer + fn->numLocals;
+    }
+
     void VM::callFunction(std::shared_ptr<Closure> cl, int numArgs) {
-        auto fn = cl->fn;
+        auto& fn = cl->fn;
         if (numArgs != fn->numParameters) {
             throw RunningError{"wrong number of arguments, want=" + std::to_string(fn->numParameters) + ", got=" + std::to_string(numArgs)};
         }
+        // 一次检查整个调用需要的栈空间, push/pop 不再逐次检查
+        if (sp - numArgs + fn->numLocals + fn->maxStackDepth > StackSize) {
+            throw RunningError{"stack overflow"};
+        }
         auto frame = std::make_shared<Frame>(cl, sp-numArgs);
         pushFrame(frame);
         sp = frame->basePointer + fn->numLocals;
     }
 
-    void VM::callBuiltin(std::shared_ptr<Builtin> fn, int numArgs) {
-        std::vector<std::shared_ptr<Object>> args;
-        for (int i = sp-numArgs; i < sp; ++i) {
-            args.emplace_back(stack[i]);
+    void VM::callBuiltin(Builtin* fn, int numArgs) {
+        if (runtimeStats.enabled) {
+            ++runtimeStats.builtinCalls[fn->name];
         }
-        auto result = fn->fn(args);
+        // 实参留在栈上, 内置函数通过 ArgsView 直接读取
+        auto result = fn->call(ArgsView(stack.data() + sp - numArgs, numArgs, this));
         sp -= numArgs + 1;
         if (result) {
             push(result);
@@ -391,12 +546,9 @@ namespace monkey {
         }
     }
 
+    // 常量的类型和自由变量个数已由 VerifyBytecode 检查
     void VM::pushClosure(int const_index, int num_free) {
-        auto constant = (*constants)[const_index];
-        if (!std::dynamic_pointer_cast<CompiledFunction>(constant)) {
-            throw RunningError{"not a function: " + constant->type()};
-        } 
-        auto compiled_fn = std::dynamic_pointer_cast<CompiledFunction>(constant);
+        auto compiled_fn = std::static_pointer_cast<CompiledFunction>((*constants)[const_index]);
         std::vector<std::shared_ptr<Object>> free;
         for (int i = 0; i < num_free; ++i) {
             free.emplace_back(stack[sp-num_free+i]);
@@ -455,19 +607,16 @@ namespace monkey {
         return true;
     }
 
+    // 调用时已按 maxStackDepth 检查过栈空间, 这里不再检查
     void VM::push(std::shared_ptr<Object> obj) {
-        if (sp >= StackSize) {
-            throw RunningError{"stack overflow"};
+        stack[sp++] = std::move(obj);
+        if (runtimeStats.enabled && sp > runtimeStats.peakStackDepth) {
+            runtimeStats.peakStackDepth = sp;
         }
-        stack[sp++] = obj;
     }
 
     std::shared_ptr<Object> VM::pop() {
-        if (sp == 0) {
-            return nullptr;
-        }
-        auto obj = stack[--sp];
-        return obj;
+        return stack[--sp];
     }
 
     std::shared_ptr<Frame> VM::currentFrame() {
@@ -479,12 +628,13 @@ namespace monkey {
             throw RunningError{"frames overflow"};
         }
         frames[framesIndex++] = frame;
+        if (runtimeStats.enabled && framesIndex > runtimeStats.peakFrameDepth) {
+            runtimeStats.peakFrameDepth = framesIndex;
+        }
     }
 
+    // 主程序中的返回指令无法通过校验, 这里不会弹出主程序的帧
     std::shared_ptr<Frame> VM::popFrame() {
-        if (framesIndex == 0) {
-            return nullptr;
-        }
         return frames[--framesIndex];
     }
 } // namespace monkey
\ No newline at end of file